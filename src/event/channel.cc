@@ -13,10 +13,11 @@ namespace Tnet {
 const int Channel::kNoneEvent = 0;
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
 const int Channel::kWriteEvent = EPOLLOUT;
+const int Channel::kEdgeEvent = EPOLLET;
 
 // EventLoop: ChannelList Poller
 Channel::Channel(EventLoop* loop, int fd)
-    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), tied_(false) {}
+    : loop_(loop), fd_(fd), events_(0), revents_(0), tied_(false) {}
 
 Channel::~Channel() {
   if (loop_->isInLoopThread()) {
@@ -56,6 +57,8 @@ std::string Channel::eventsToString(int fd, int ev) {
     oss << "RDHUP ";
   if (ev & EPOLLERR)
     oss << "ERR ";
+  if (ev & EPOLLET)
+    oss << "ET ";
 
   return oss.str();
 }
@@ -1,18 +1,13 @@
 #include "epoller.h"
 
-#include <assert.h>
+#include <stdlib.h>
 
 #include "event/channel.h"
+#include "event/uringpoller.h"
 #include "util/log.h"
 
 namespace Tnet {
 
-const int kNew = -1;  // 某个channel还没添加至Poller
-                      // channel的成员index_初始化为-1
-
-const int kAdded = 1;    // 某个channel已经添加至Poller
-const int kDeleted = 2;  // 某个channel已经从Poller删除
-
 Epoller::Epoller(EventLoop* loop)
     : Poller(loop),
       epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
@@ -27,7 +22,13 @@ Epoller::~Epoller() {
 }
 
 Timestamp Epoller::poll(int timeoutMs, ChannelList* activeChannels) {
-  LOG_DEBUG("func=%s => fd total count:%lu\n", __FUNCTION__, channels_.size());
+  // 忙轮询以零超时反复调用，LOG_DEBUG每次都会格式化字符串，这时不记录
+  if (timeoutMs != 0) {
+    LOG_DEBUG("func=%s => fd total count:%lu\n", __FUNCTION__, numChannels_);
+  }
+
+  // 提交上一轮积累的关注事件修改
+  flushDirty();
 
   int numEvents = ::epoll_wait(epollfd_, &*events_.begin(),
                                static_cast<int>(events_.size()), timeoutMs);
@@ -40,7 +41,9 @@ Timestamp Epoller::poll(int timeoutMs, ChannelList* activeChannels) {
       events_.resize(events_.size() * 2);
     }
   } else if (numEvents == 0) {
-    LOG_DEBUG("%s timeout!\n", __FUNCTION__);
+    if (timeoutMs != 0) {
+      LOG_DEBUG("%s timeout!\n", __FUNCTION__);
+    }
   } else {
     if (saveErrno != EINTR) {
       errno = saveErrno;
@@ -51,49 +54,52 @@ Timestamp Epoller::poll(int timeoutMs, ChannelList* activeChannels) {
 }
 
 void Epoller::updateChannel(Channel* channel) {
-  const int index = channel->index();
-  LOG_INFO("func=%s => fd=%d events=%d index=%d\n", __FUNCTION__, channel->fd(),
-           channel->events(), index);
-
-  if (index == kNew || index == kDeleted) {
-    // a new one, add with EPOLL_CTL_ADD
-    int fd = channel->fd();
-    if (index == kNew) {
-      assert(channels_.find(fd) == channels_.end());
-      channels_[fd] = channel;
-    } else {
-      assert(channels_.find(fd) != channels_.end());
-      assert(channels_[fd] == channel);
-    }
-
-    channel->set_index(kAdded);
-    update(EPOLL_CTL_ADD, channel);
-  } else {
-    int fd = channel->fd();
-    assert(channels_.find(fd) != channels_.end());
-
-    if (channel->isNoneEvent()) {
-      update(EPOLL_CTL_DEL, channel);
-      channel->set_index(kDeleted);
-    } else {
-      update(EPOLL_CTL_MOD, channel);
-    }
-  }
+  // 真正的epoll_ctl推迟到下一次epoll_wait之前
+  markDirty(&updateEntry(channel), channel->fd());
 }
 
 void Epoller::removeChannel(Channel* channel) {
-  int fd = channel->fd();
-  channels_.erase(fd);
-
-  LOG_INFO("func=%s => fd=%d\n", __FUNCTION__, fd);
-
-  int index = channel->index();
-  if (index == kAdded) {
+  ChannelEntry* entry = removeEntry(channel);
+  // channel即将析构、fd即将关闭，不能推迟，立即从内核中删除
+  if (entry != nullptr && entry->registered) {
     update(EPOLL_CTL_DEL, channel);
+    entry->registered = false;
+    entry->events = 0;
   }
+}
 
-  // kNew kDeleted ?
-  channel->set_index(kNew);
+void Epoller::markDirty(ChannelEntry* entry, int fd) {
+  if (!entry->dirty) {
+    entry->dirty = true;
+    dirtyFds_.push_back(fd);
+  }
+}
+
+void Epoller::flushDirty() {
+  for (int fd : dirtyFds_) {
+    ChannelEntry& entry = channels_[fd];
+    entry.dirty = false;
+    Channel* channel = entry.channel;
+    if (channel == nullptr) {
+      continue;  // 已经removeChannel
+    }
+    uint32_t events =
+        entry.state == kAdded ? static_cast<uint32_t>(channel->events()) : 0;
+
+    if (events == 0) {
+      if (entry.registered) {
+        update(EPOLL_CTL_DEL, channel);
+        entry.registered = false;
+      }
+    } else if (!entry.registered) {
+      update(EPOLL_CTL_ADD, channel);
+      entry.registered = true;
+    } else if (entry.events != events) {
+      update(EPOLL_CTL_MOD, channel);
+    }
+    entry.events = events;
+  }
+  dirtyFds_.clear();
 }
 
 void Epoller::fillActiveChannels(int numEvents,
@@ -124,7 +130,16 @@ void Epoller::update(int operation, Channel* channel) {
   }
 }
 
+// 设置环境变量TNET_USE_URING时使用io_uring，内核不支持则回退到epoll
 Poller* newDefaultPoller(EventLoop* loop) {
+  if (::getenv("TNET_USE_URING")) {
+    UringPoller* poller = new UringPoller(loop);
+    if (poller->valid()) {
+      return poller;
+    }
+    LOG_WARN("io_uring is not available, fall back to epoll\n");
+    delete poller;
+  }
   return new Epoller(loop);
 }
 
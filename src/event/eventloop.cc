@@ -2,13 +2,17 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <string.h>
 #include <sys/eventfd.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <memory>
 
 #include "event/channel.h"
 #include "event/poller.h"
+#include "event/timerqueue.h"
+#include "event/timingwheel.h"
 #include "util/log.h"
 
 namespace Tnet {
@@ -19,6 +23,32 @@ __thread EventLoop* t_loopInThisThread = nullptr;
 // 定义默认的Poller IO复用接口的超时时间
 const int kPollTimeMs = 10000;  // 10000毫秒 = 10秒钟
 
+// 利用率滑动平均的时间窗口
+const double kUtilizationWindowUs = 1000 * 1000;
+
+// 每个循环预分配的队列节点数，用完后退回到堆上分配
+const uint32_t kTaskPoolSize = 1024;
+// 空闲链表中表示链表结束的下标
+const uint32_t kNoFreeTask = 0xffffffff;
+
+struct EventLoop::PendingTask : public MpscNode {
+  PendingTask() : nextFree(kNoFreeTask) {}
+  explicit PendingTask(Functor f)
+      : functor(std::move(f)), nextFree(kNoFreeTask) {}
+
+  Functor functor;
+  // 空闲链表中下一个节点的下标。取节点的生产者可能读到已被别人取走的节点，
+  // 版本号保证这种情况下CAS失败，所以只需要原子读写，不需要更强的顺序
+  std::atomic<uint32_t> nextFree;
+};
+
+// 墙上时钟可能回拨，差值为负时按0计
+static uint64_t elapsedMicroSeconds(Timestamp start, Timestamp end) {
+  int64_t diff =
+      end.microSecondsSinceEpoch() - start.microSecondsSinceEpoch();
+  return diff > 0 ? static_cast<uint64_t>(diff) : 0;
+}
+
 int createEventfd() {
   int evtfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
   if (evtfd < 0) {
@@ -32,9 +62,25 @@ EventLoop::EventLoop()
       quit_(false),
       threadId_(CurrentThread::tid()),
       poller_(newDefaultPoller(this)),
-      callingPendingFunctors_(false),
+      timerQueue_(new TimerQueue(this)),
+      timingWheel_(new TimingWheel(this)),
       wakeupFd_(createEventfd()),
-      wakeupChannel_(new Channel(this, wakeupFd_)) {
+      wakeupChannel_(new Channel(this, wakeupFd_)),
+      pendingCount_(0),
+      maxPendingCount_(0),
+      sleeping_(false),
+      wakeupCount_(0),
+      taskPool_(new PendingTask[kTaskPoolSize]),
+      freeTaskHead_(0),
+      busyPollUs_(0),
+      callbackSeq_(0),
+      callbackStartUs_(0),
+      callbackFd_(-1),
+      currentChannel_(nullptr),
+      utilization_(0.0),
+      utilizationPpm_(0),
+      connectionCount_(0),
+      readScratch_(new char[kReadScratchSize]) {
   LOG_INFO("Create EventLoop in thread -> [%d]\n", threadId_);
   if (t_loopInThisThread) {
     LOG_ERROR("Another EventLoop %p exists in this thread %d\n",
@@ -43,17 +89,30 @@ EventLoop::EventLoop()
     t_loopInThisThread = this;
   }
 
+  for (std::atomic<uint64_t>& word : callbackName_) {
+    word.store(0, std::memory_order_relaxed);
+  }
+  for (uint32_t i = 0; i + 1 < kTaskPoolSize; ++i) {
+    taskPool_[i].nextFree.store(i + 1, std::memory_order_relaxed);
+  }
+
+  wakeupChannel_->setName("EventLoop wakeup");
   wakeupChannel_->setReadCallback(std::bind(&EventLoop::handleRead, this));
   wakeupChannel_->enableReading();
 }
 
 EventLoop::~EventLoop() {
+  while (PendingTask* task = pendingFunctors_.pop()) {
+    freeTask(task);
+  }
   wakeupChannel_->disableAll();
   wakeupChannel_->remove();
   ::close(wakeupFd_);
   t_loopInThisThread = nullptr;
 }
 
+EventLoop* EventLoop::loopOfCurrentThread() { return t_loopInThisThread; }
+
 void EventLoop::abortNotInLoopThread() {
   LOG_ERROR(
       "EventLoop::abortNotInLoopThread was created in threadId_ %d ,current "
@@ -69,18 +128,108 @@ void EventLoop::loop() {
 
   while (!quit_) {
     activeChannels_.clear();
-    pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+    Timestamp pollStart(Timestamp::now());
+
+    if (busyPollUs_ <= 0 || !busyPoll()) {
+      // 先声明即将睡眠再检查队列，与queueInLoop中的先入队后检查配对，
+      // 保证要么这里看到新回调而不阻塞，要么生产者看到睡眠标志而唤醒。
+      sleeping_.store(true, std::memory_order_seq_cst);
+      int timeoutMs =
+          pendingCount_.load(std::memory_order_seq_cst) > 0 ? 0 : kPollTimeMs;
+      pollReturnTime_ = poller_->poll(timeoutMs, &activeChannels_);
+      sleeping_.store(false, std::memory_order_relaxed);
+    }
 
+    // 上一个回调的结束时间即下一个回调的开始时间
+    Timestamp callbackStart = pollReturnTime_;
     for (auto* channel : activeChannels_) {
+      beginCallback(callbackStart, channel);
       channel->handleEvent(pollReturnTime_);
+      callbackStart = Timestamp::now();
     }
+    Timestamp dispatchEnd = callbackStart;
 
-    doPendingFunctors();
+    LoopSample sample;
+    beginCallback(dispatchEnd, nullptr);
+    sample.functors = doPendingFunctors();
+    sample.functors += doIterationEndFunctors();
+    Timestamp functorEnd(Timestamp::now());
+    endCallback();
+
+    sample.pollWaitUs = elapsedMicroSeconds(pollStart, pollReturnTime_);
+    sample.events = activeChannels_.size();
+    sample.dispatchUs = elapsedMicroSeconds(pollReturnTime_, dispatchEnd);
+    sample.functorUs = elapsedMicroSeconds(dispatchEnd, functorEnd);
+    stats_.record(sample);
+    updateUtilization(sample);
   }
   LOG_INFO("EventLoop %p stop looping.\n", this);
   looping_.store(false, std::memory_order_release);
 }
 
+// 在预算时间内以零超时poll并检查回调队列，有事可做立即返回true；
+// 预算耗尽仍然空闲则返回false，由调用者退回阻塞的poll
+bool EventLoop::busyPoll() {
+  Timestamp deadline(Timestamp::now().microSecondsSinceEpoch() + busyPollUs_);
+  do {
+    pollReturnTime_ = poller_->poll(0, &activeChannels_);
+    if (!activeChannels_.empty() ||
+        pendingCount_.load(std::memory_order_acquire) > 0 ||
+        quit_.load(std::memory_order_acquire)) {
+      return true;
+    }
+  } while (pollReturnTime_ < deadline);
+  return false;
+}
+
+// 先写回调信息再发布序号，Watchdog读到新序号时一定能看到对应的信息
+void EventLoop::beginCallback(Timestamp start, Channel* channel) {
+  currentChannel_.store(channel, std::memory_order_relaxed);
+  callbackFd_.store(channel != nullptr ? channel->fd() : -1,
+                    std::memory_order_relaxed);
+  if (channel != nullptr) {
+    publishCallbackName(channel->name());
+  }
+  callbackStartUs_.store(start.microSecondsSinceEpoch(),
+                         std::memory_order_relaxed);
+  callbackSeq_.store(callbackSeq_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_release);
+}
+
+// 只写到结尾的'\0'所在的字，通常是几次store
+void EventLoop::publishCallbackName(const std::string& name) {
+  char buf[sizeof(callbackName_)] = {};
+  std::size_t len = std::min(name.size(), sizeof(buf) - 1);
+  ::memcpy(buf, name.data(), len);
+  std::size_t words = len / sizeof(uint64_t) + 1;
+  for (std::size_t i = 0; i < words; ++i) {
+    uint64_t word;
+    ::memcpy(&word, buf + i * sizeof(uint64_t), sizeof(word));
+    callbackName_[i].store(word, std::memory_order_relaxed);
+  }
+}
+
+void EventLoop::endCallback() {
+  currentChannel_.store(nullptr, std::memory_order_relaxed);
+  callbackStartUs_.store(0, std::memory_order_relaxed);
+  callbackSeq_.store(callbackSeq_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_release);
+}
+
+// 按本轮的时长加权的指数滑动平均，空闲时长时间阻塞的一轮会迅速拉低利用率
+void EventLoop::updateUtilization(const LoopSample& sample) {
+  double busy = static_cast<double>(sample.dispatchUs + sample.functorUs);
+  double total = busy + static_cast<double>(sample.pollWaitUs);
+  if (total <= 0) {
+    return;
+  }
+  double weight =
+      total < kUtilizationWindowUs ? total / kUtilizationWindowUs : 1.0;
+  utilization_ += (busy / total - utilization_) * weight;
+  utilizationPpm_.store(static_cast<uint32_t>(utilization_ * 1e6),
+                        std::memory_order_relaxed);
+}
+
 void EventLoop::quit() {
   quit_.store(true, std::memory_order_release);
 
@@ -90,6 +239,7 @@ void EventLoop::quit() {
 }
 
 void EventLoop::wakeup() {
+  wakeupCount_.fetch_add(1, std::memory_order_relaxed);
   uint64_t one = 1;
   ssize_t n = write(wakeupFd_, &one, sizeof(one));
   if (n != sizeof(one)) {
@@ -97,37 +247,120 @@ void EventLoop::wakeup() {
   }
 }
 
-void EventLoop::doPendingFunctors() {
-  std::vector<Functor> functors;
-  callingPendingFunctors_.store(true, std::memory_order_release);
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb) {
+  return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
 
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    functors.swap(pendingFunctors_);
+TimerId EventLoop::runAfter(double delay, TimerCallback cb) {
+  Timestamp time(addTime(Timestamp::now(), delay));
+  return runAt(time, std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb) {
+  Timestamp time(addTime(Timestamp::now(), interval));
+  return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+void EventLoop::cancel(TimerId timerId) {
+  return timerQueue_->cancel(timerId);
+}
+
+std::size_t EventLoop::doPendingFunctors() {
+  // 只执行进入本函数时已在队列中的回调，执行期间新加入的留到下一轮，
+  // 避免源源不断的回调饿死IO事件
+  std::size_t count = pendingCount_.load(std::memory_order_acquire);
+  std::size_t i = 0;
+  for (; i < count; ++i) {
+    PendingTask* task = pendingFunctors_.pop();
+    if (task == nullptr) {
+      break;  // 生产者尚未完成入队，下一轮再取
+    }
+    pendingCount_.fetch_sub(1, std::memory_order_relaxed);
+    task->functor();  // 执行当前loop需要执行的回调操作
+    freeTask(task);
   }
+  return i;
+}
 
-  for (const Functor& functor : functors) {
-    functor();  // 执行当前loop需要执行的回调操作
+// 末尾回调执行期间新加入的也在本轮执行，直到没有新的为止
+std::size_t EventLoop::doIterationEndFunctors() {
+  std::size_t count = 0;
+  while (!iterationEndFunctors_.empty()) {
+    runningIterationEnd_.swap(iterationEndFunctors_);
+    for (Functor& functor : runningIterationEnd_) {
+      functor();
+    }
+    count += runningIterationEnd_.size();
+    runningIterationEnd_.clear();
   }
+  return count;
+}
+
+void EventLoop::runAtIterationEnd(Functor cb) {
+  assertInLoopThread();
+  iterationEndFunctors_.push_back(std::move(cb));
+}
+
+// 从预分配的节点中取一个，任意线程都可以调用，节点用完时才在堆上分配
+EventLoop::PendingTask* EventLoop::newTask(Functor cb) {
+  uint64_t head = freeTaskHead_.load(std::memory_order_acquire);
+  for (;;) {
+    uint32_t index = static_cast<uint32_t>(head);
+    if (index == kNoFreeTask) {
+      return new PendingTask(std::move(cb));
+    }
+    PendingTask* task = &taskPool_[index];
+    uint64_t next = ((head >> 32) + 1) << 32 |
+                    task->nextFree.load(std::memory_order_relaxed);
+    if (freeTaskHead_.compare_exchange_weak(head, next,
+                                            std::memory_order_acquire,
+                                            std::memory_order_acquire)) {
+      task->functor = std::move(cb);
+      return task;
+    }
+  }
+}
 
-  callingPendingFunctors_.store(false, std::memory_order_release);
+// 只在循环线程中调用，预分配的节点放回空闲链表，堆上分配的直接释放
+void EventLoop::freeTask(PendingTask* task) {
+  if (task < taskPool_.get() || task >= taskPool_.get() + kTaskPoolSize) {
+    delete task;
+    return;
+  }
+  task->functor = nullptr;  // 及时释放捕获的对象（如TcpConnectionPtr）
+  uint32_t index = static_cast<uint32_t>(task - taskPool_.get());
+  uint64_t head = freeTaskHead_.load(std::memory_order_relaxed);
+  uint64_t next;
+  do {
+    task->nextFree.store(static_cast<uint32_t>(head),
+                         std::memory_order_relaxed);
+    next = ((head >> 32) + 1) << 32 | index;
+  } while (!freeTaskHead_.compare_exchange_weak(
+      head, next, std::memory_order_release, std::memory_order_relaxed));
 }
 
 void EventLoop::runInLoop(Functor cb) {
   if (isInLoopThread()) {
     cb();
   } else {
-    queueInLoop(cb);
+    queueInLoop(std::move(cb));
   }
 }
 
 void EventLoop::queueInLoop(Functor cb) {
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    pendingFunctors_.emplace_back(cb);
+  std::size_t depth =
+      pendingCount_.fetch_add(1, std::memory_order_seq_cst) + 1;
+  pendingFunctors_.push(newTask(std::move(cb)));
+
+  std::size_t maxDepth = maxPendingCount_.load(std::memory_order_relaxed);
+  while (depth > maxDepth &&
+         !maxPendingCount_.compare_exchange_weak(maxDepth, depth,
+                                                 std::memory_order_relaxed)) {
   }
 
-  if (!isInLoopThread() || callingPendingFunctors_) {
+  // 只有循环阻塞在poll中时才需要写eventfd，且每次睡眠只由一个生产者唤醒
+  if (sleeping_.load(std::memory_order_seq_cst) &&
+      sleeping_.exchange(false, std::memory_order_seq_cst)) {
     wakeup();
   }
 }
@@ -152,4 +385,8 @@ bool EventLoop::hasChannel(Channel* channel) {
   return poller_->hasChannel(channel);
 }
 
+bool EventLoop::edgeTriggeredSupported() const {
+  return poller_->edgeTriggeredSupported();
+}
+
 }  // namespace Tnet
@@ -0,0 +1,115 @@
+#include "event/loopstats.h"
+
+#include <string.h>
+
+namespace Tnet {
+
+const int Histogram::kBuckets;
+
+Histogram::Histogram() : count(0), sum(0), max(0) {
+  ::memset(buckets, 0, sizeof(buckets));
+}
+
+int Histogram::bucketOf(uint64_t value) {
+  if (value == 0) {
+    return 0;
+  }
+  int bucket = 64 - __builtin_clzll(value);
+  return bucket < kBuckets ? bucket : kBuckets - 1;
+}
+
+void Histogram::add(uint64_t value) {
+  ++count;
+  sum += value;
+  if (value > max) {
+    max = value;
+  }
+  ++buckets[bucketOf(value)];
+}
+
+uint64_t Histogram::percentile(double p) const {
+  if (count == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count));
+  if (rank >= count) {
+    rank = count - 1;
+  }
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    seen += buckets[i];
+    if (seen > rank) {
+      uint64_t upper = i == 0 ? 0 : (uint64_t(1) << i) - 1;
+      return upper < max ? upper : max;
+    }
+  }
+  return max;
+}
+
+// 单写者，读改写拆成relaxed的load和store即可
+static void bump(std::atomic<uint64_t>* value, uint64_t delta) {
+  value->store(value->load(std::memory_order_relaxed) + delta,
+               std::memory_order_relaxed);
+}
+
+LoopStatsRecorder::AtomicHistogram::AtomicHistogram()
+    : count_(0), sum_(0), max_(0) {
+  for (std::atomic<uint64_t>& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+void LoopStatsRecorder::AtomicHistogram::add(uint64_t value) {
+  bump(&count_, 1);
+  bump(&sum_, value);
+  if (value > max_.load(std::memory_order_relaxed)) {
+    max_.store(value, std::memory_order_relaxed);
+  }
+  bump(&buckets_[Histogram::bucketOf(value)], 1);
+}
+
+void LoopStatsRecorder::AtomicHistogram::load(Histogram* out) const {
+  out->count = count_.load(std::memory_order_relaxed);
+  out->sum = sum_.load(std::memory_order_relaxed);
+  out->max = max_.load(std::memory_order_relaxed);
+  for (int i = 0; i < Histogram::kBuckets; ++i) {
+    out->buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+}
+
+LoopStatsRecorder::LoopStatsRecorder() : seq_(0), iterations_(0) {}
+
+void LoopStatsRecorder::record(const LoopSample& sample) {
+  uint64_t seq = seq_.load(std::memory_order_relaxed);
+  seq_.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  bump(&iterations_, 1);
+  pollWaitUs_.add(sample.pollWaitUs);
+  eventsPerIteration_.add(sample.events);
+  dispatchUs_.add(sample.dispatchUs);
+  functorsPerIteration_.add(sample.functors);
+  functorUs_.add(sample.functorUs);
+
+  seq_.store(seq + 2, std::memory_order_release);
+}
+
+LoopStats LoopStatsRecorder::snapshot() const {
+  LoopStats stats;
+  uint64_t begin;
+  uint64_t end;
+  do {
+    begin = seq_.load(std::memory_order_acquire);
+    stats.iterations = iterations_.load(std::memory_order_relaxed);
+    pollWaitUs_.load(&stats.pollWaitUs);
+    eventsPerIteration_.load(&stats.eventsPerIteration);
+    dispatchUs_.load(&stats.dispatchUs);
+    functorsPerIteration_.load(&stats.functorsPerIteration);
+    functorUs_.load(&stats.functorUs);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    end = seq_.load(std::memory_order_relaxed);
+  } while ((begin & 1) != 0 || begin != end);
+  return stats;
+}
+
+}  // namespace Tnet
@@ -1,12 +1,70 @@
 #include "event/poller.h"
 #include "event/channel.h"
 
+#include <assert.h>
+
+#include "util/log.h"
+
 namespace Tnet {
-Poller::Poller(EventLoop *loop) : ownerLoop_(loop) {}
+
+static const size_t kInitChannelTableSize = 64;
+
+Poller::Poller(EventLoop *loop) : numChannels_(0), ownerLoop_(loop) {}
 
 bool Poller::hasChannel(Channel *channel) const {
-  auto it = channels_.find(channel->fd());
-  return it != channels_.end() && it->second == channel;
+  const ChannelEntry *entry = findEntry(channel->fd());
+  return entry != nullptr && entry->channel == channel;
+}
+
+Poller::ChannelEntry &Poller::channelEntry(int fd) {
+  assert(fd >= 0);
+  size_t index = static_cast<size_t>(fd);
+  if (index >= channels_.size()) {
+    size_t size = channels_.empty() ? kInitChannelTableSize : channels_.size();
+    while (size <= index) {
+      size *= 2;
+    }
+    channels_.resize(size);
+  }
+  return channels_[index];
+}
+
+Poller::ChannelEntry &Poller::updateEntry(Channel *channel) {
+  const int fd = channel->fd();
+  ChannelEntry &entry = channelEntry(fd);
+  LOG_INFO("func=%s => fd=%d events=%d state=%d\n", __FUNCTION__, fd,
+           channel->events(), entry.state);
+
+  if (entry.state == kNew || entry.state == kDeleted) {
+    if (entry.state == kNew) {
+      assert(entry.channel == nullptr);
+      entry.channel = channel;
+      ++numChannels_;
+    } else {
+      assert(entry.channel == channel);
+    }
+    entry.state = kAdded;
+  } else {
+    assert(entry.channel == channel);
+    if (channel->isNoneEvent()) {
+      entry.state = kDeleted;
+    }
+  }
+  return entry;
+}
+
+Poller::ChannelEntry *Poller::removeEntry(Channel *channel) {
+  const int fd = channel->fd();
+  LOG_INFO("func=%s => fd=%d\n", __FUNCTION__, fd);
+
+  ChannelEntry *entry = findEntry(fd);
+  if (entry == nullptr || entry->channel != channel) {
+    return nullptr;  // 从未添加至Poller
+  }
+  entry->channel = nullptr;
+  entry->state = kNew;
+  --numChannels_;
+  return entry;
 }
 
-}  // namespace Tnet
\ No newline at end of file
+}  // namespace Tnet
@@ -0,0 +1,185 @@
+#include "event/timingwheel.h"
+
+#include <math.h>
+
+#include "event/eventloop.h"
+
+namespace Tnet {
+
+constexpr double TimingWheel::kDefaultTick;
+
+// 把from上的所有节点整体移动到空链表to上
+static void moveList(WheelLink* from, WheelLink* to) {
+  if (from->empty()) {
+    return;
+  }
+  to->next = from->next;
+  to->prev = from->prev;
+  to->next->prev = to;
+  to->prev->next = to;
+  from->next = from->prev = from;
+}
+
+WheelTimer::~WheelTimer() {
+  if (wheel_ != nullptr) {
+    wheel_->cancel(this);
+  }
+}
+
+TimingWheel::TimingWheel(EventLoop* loop, double tickSeconds)
+    : loop_(loop),
+      tick_(tickSeconds),
+      current_(0),
+      size_(0),
+      ticking_(false) {}
+
+TimingWheel::~TimingWheel() {
+  stopTicking();
+  // 剩余的WheelTimer由使用者持有，这里只负责摘下
+  for (WheelLink& slot : root_) {
+    while (!slot.empty()) {
+      cancel(slot.next->owner);
+    }
+  }
+  for (auto& level : levels_) {
+    for (WheelLink& slot : level) {
+      while (!slot.empty()) {
+        cancel(slot.next->owner);
+      }
+    }
+  }
+}
+
+void TimingWheel::arm(WheelTimer* timer, double timeout) {
+  loop_->assertInLoopThread();
+  if (timer->wheel_ == this) {
+    timer->unlink();
+  } else {
+    if (timer->wheel_ != nullptr) {
+      timer->wheel_->cancel(timer);
+    }
+    timer->wheel_ = this;
+    ++size_;
+  }
+
+  uint64_t ticks = static_cast<uint64_t>(ceil(timeout / tick_));
+  if (ticks == 0) {
+    ticks = 1;
+  } else if (ticks > kMaxTicks) {
+    ticks = kMaxTicks;
+  }
+  // current_这个tick随时可能被处理，不能计入超时时间，
+  // 否则最多会提前一个tick触发
+  timer->expire_ = current_ + ticks;
+  link(timer);
+
+  if (!ticking_) {
+    startTicking();
+  }
+}
+
+void TimingWheel::cancel(WheelTimer* timer) {
+  if (timer->wheel_ != this) {
+    return;
+  }
+  timer->unlink();
+  timer->wheel_ = nullptr;
+  --size_;
+}
+
+void TimingWheel::link(WheelTimer* timer) {
+  uint64_t expire = timer->expire_;
+  uint64_t delta = expire - current_;
+  WheelLink* slot = nullptr;
+
+  if (expire < current_) {
+    // 级联时已经过期的定时器放到下一个要处理的槽位
+    slot = &root_[current_ & kRootMask];
+  } else if (delta < kRootSize) {
+    slot = &root_[expire & kRootMask];
+  } else {
+    for (int level = 1; level < kLevels; ++level) {
+      int shift = kRootBits + level * kLevelBits;
+      if (delta < (uint64_t(1) << shift) || level == kLevels - 1) {
+        int lowShift = kRootBits + (level - 1) * kLevelBits;
+        slot = &levels_[level - 1][(expire >> lowShift) & kLevelMask];
+        break;
+      }
+    }
+  }
+
+  WheelLink* node = &timer->link_;
+  node->prev = slot->prev;
+  node->next = slot;
+  slot->prev->next = node;
+  slot->prev = node;
+}
+
+// 把上层某个槽位的定时器重新分配到更低的层
+void TimingWheel::cascade(int level, uint64_t index) {
+  WheelLink pending;
+  moveList(&levels_[level - 1][index], &pending);
+
+  while (!pending.empty()) {
+    WheelTimer* timer = pending.next->owner;
+    timer->unlink();
+    link(timer);
+  }
+}
+
+void TimingWheel::advance() {
+  uint64_t index = current_ & kRootMask;
+  if (index == 0) {
+    for (int level = 1; level < kLevels; ++level) {
+      int shift = kRootBits + (level - 1) * kLevelBits;
+      uint64_t levelIndex = (current_ >> shift) & kLevelMask;
+      cascade(level, levelIndex);
+      if (levelIndex != 0) {
+        break;
+      }
+    }
+  }
+  ++current_;
+
+  // 先摘到临时链表上，回调中可以安全地arm/cancel任意定时器
+  WheelLink expired;
+  moveList(&root_[index], &expired);
+
+  while (!expired.empty()) {
+    WheelTimer* timer = expired.next->owner;
+    cancel(timer);
+    if (timer->callback_) {
+      timer->callback_();
+    }
+  }
+}
+
+void TimingWheel::handleTick() {
+  Timestamp now(Timestamp::now());
+  int64_t elapsed =
+      static_cast<int64_t>(timeDifference(now, lastTick_) / tick_);
+  for (int64_t i = 0; i < elapsed; ++i) {
+    advance();
+  }
+  lastTick_ = addTime(lastTick_, static_cast<double>(elapsed) * tick_);
+
+  if (size_ == 0) {
+    stopTicking();
+  }
+}
+
+void TimingWheel::startTicking() {
+  ticking_ = true;
+  lastTick_ = Timestamp::now();
+  tickTimer_ =
+      loop_->runEvery(tick_, std::bind(&TimingWheel::handleTick, this));
+}
+
+void TimingWheel::stopTicking() {
+  if (ticking_) {
+    ticking_ = false;
+    loop_->cancel(tickTimer_);
+  }
+}
+
+}  // namespace Tnet
@@ -0,0 +1,309 @@
+#include "event/uringpoller.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "event/channel.h"
+#include "util/log.h"
+
+namespace Tnet {
+
+// poll不支持边缘触发，提交前去掉EPOLLET
+static uint32_t pollEvents(const Channel* channel) {
+  return static_cast<uint32_t>(channel->events()) & ~EPOLLET;
+}
+
+// POLL_ADD的user_data，高32位是表项的generation，0保留给取消操作
+static uint64_t pollToken(int fd, uint32_t generation) {
+  return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+}
+
+UringPoller::UringPoller(EventLoop* loop)
+    : Poller(loop),
+      ringfd_(-1),
+      sqRing_(MAP_FAILED),
+      sqRingSize_(0),
+      sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)),
+      sqesSize_(0),
+      sqPending_(0),
+      cqRing_(MAP_FAILED),
+      cqRingSize_(0) {
+  if (!setupRing()) {
+    LOG_ERROR("UringPoller: io_uring setup error:%d\n", errno);
+    if (ringfd_ >= 0) {
+      ::close(ringfd_);
+      ringfd_ = -1;
+    }
+  }
+}
+
+UringPoller::~UringPoller() {
+  if (sqes_ != MAP_FAILED) {
+    ::munmap(sqes_, sqesSize_);
+  }
+  if (sqRing_ != MAP_FAILED) {
+    ::munmap(sqRing_, sqRingSize_);
+  }
+  if (ringfd_ >= 0) {
+    ::close(ringfd_);
+  }
+}
+
+bool UringPoller::setupRing() {
+  io_uring_params params;
+  ::memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = kRingEntries * 4;
+
+  ringfd_ = static_cast<int>(
+      ::syscall(__NR_io_uring_setup, kRingEntries, &params));
+  if (ringfd_ < 0) {
+    return false;
+  }
+
+  // 等待超时依赖EXT_ARG，单次mmap依赖SINGLE_MMAP
+  if (!(params.features & IORING_FEAT_EXT_ARG) ||
+      !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+    errno = ENOSYS;
+    return false;
+  }
+
+  sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (cqRingSize_ > sqRingSize_) {
+    sqRingSize_ = cqRingSize_;
+  }
+  sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ringfd_, IORING_OFF_SQ_RING);
+  if (sqRing_ == MAP_FAILED) {
+    return false;
+  }
+  cqRing_ = sqRing_;
+  cqRingSize_ = sqRingSize_;
+
+  sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = static_cast<io_uring_sqe*>(
+      ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ringfd_, IORING_OFF_SQES));
+  if (sqes_ == MAP_FAILED) {
+    return false;
+  }
+
+  char* sq = static_cast<char*>(sqRing_);
+  sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+  char* cq = static_cast<char*>(cqRing_);
+  cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  return true;
+}
+
+// 取一个空闲的sqe，提交队列满时先把已有的sqe提交给内核。
+// 填好的sqe只累计在sqPending_中，统一在enter()时发布给内核。
+io_uring_sqe* UringPoller::getSqe() {
+  unsigned tail = *sqTail_ + sqPending_;
+  unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+  if (tail - head > *sqMask_) {
+    enter(0, 0, -1);
+    head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (tail - head > *sqMask_) {
+      return nullptr;
+    }
+  }
+  io_uring_sqe* sqe = &sqes_[tail & *sqMask_];
+  ::memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+int UringPoller::enter(unsigned minComplete, unsigned flags, int timeoutMs) {
+  // 在填写sqe之后再发布tail，保证内核看到完整的sqe
+  unsigned tail = *sqTail_;
+  for (unsigned i = 0; i < sqPending_; ++i, ++tail) {
+    sqArray_[tail & *sqMask_] = tail & *sqMask_;
+  }
+  sqPending_ = 0;
+  __atomic_store_n(sqTail_, tail, __ATOMIC_RELEASE);
+  unsigned toSubmit = tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+
+  io_uring_getevents_arg arg;
+  __kernel_timespec ts;
+  ::memset(&arg, 0, sizeof(arg));
+  void* argp = nullptr;
+  size_t argsz = 0;
+  if ((flags & IORING_ENTER_GETEVENTS) && timeoutMs >= 0) {
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+    argp = &arg;
+    argsz = sizeof(arg);
+    flags |= IORING_ENTER_EXT_ARG;
+  }
+
+  return static_cast<int>(::syscall(__NR_io_uring_enter, ringfd_, toSubmit,
+                                    minComplete, flags, argp, argsz));
+}
+
+Timestamp UringPoller::poll(int timeoutMs, ChannelList* activeChannels) {
+  if (timeoutMs != 0) {  // 忙轮询的零超时poll不记录，见Epoller::poll
+    LOG_DEBUG("func=%s => fd total count:%lu\n", __FUNCTION__, numChannels_);
+  }
+
+  flushDirty();
+
+  // 提交本轮所有的poll注册/取消，并在同一次系统调用中等待完成事件
+  int ret = enter(1, IORING_ENTER_GETEVENTS, timeoutMs);
+  int saveErrno = errno;
+  Timestamp now;
+
+  if (ret < 0 && saveErrno != EINTR && saveErrno != ETIME) {
+    errno = saveErrno;
+    LOG_ERROR("UringPoller::poll() error:%d\n", saveErrno);
+  }
+  fillActiveChannels(activeChannels);
+  return now;
+}
+
+void UringPoller::updateChannel(Channel* channel) {
+  // 真正的提交推迟到下一次poll，与等待合并为一次io_uring_enter
+  markDirty(&updateEntry(channel), channel->fd());
+}
+
+void UringPoller::removeChannel(Channel* channel) {
+  // 表项保留generation，过期的完成事件不会被误认
+  ChannelEntry* entry = removeEntry(channel);
+  if (entry != nullptr && entry->registered) {
+    cancelPoll(entry, channel->fd());
+  }
+}
+
+void UringPoller::markDirty(ChannelEntry* entry, int fd) {
+  if (!entry->dirty) {
+    entry->dirty = true;
+    dirtyFds_.push_back(fd);
+  }
+}
+
+void UringPoller::flushDirty() {
+  if (!pendingCancels_.empty()) {
+    std::vector<uint64_t> pendingCancels;
+    pendingCancels.swap(pendingCancels_);
+    for (uint64_t token : pendingCancels) {
+      submitCancel(token);
+    }
+  }
+
+  std::vector<int> dirtyFds;
+  dirtyFds.swap(dirtyFds_);
+  for (int fd : dirtyFds) {
+    ChannelEntry& entry = channels_[fd];
+    if (!entry.dirty) {
+      continue;
+    }
+    entry.dirty = false;
+    Channel* channel = entry.channel;
+    if (channel == nullptr) {
+      continue;
+    }
+    uint32_t events = entry.state == kAdded ? pollEvents(channel) : 0;
+    if (entry.registered) {
+      if (entry.events == events) {
+        continue;
+      }
+      cancelPoll(&entry, fd);
+    }
+    if (events != 0) {
+      armPoll(&entry, fd);
+    }
+  }
+  // 复用已分配的容量
+  if (dirtyFds_.empty()) {
+    dirtyFds.clear();
+    dirtyFds_.swap(dirtyFds);
+  }
+}
+
+void UringPoller::armPoll(ChannelEntry* entry, int fd) {
+  io_uring_sqe* sqe = getSqe();
+  if (sqe == nullptr) {
+    LOG_ERROR("UringPoller::armPoll fd=%d submission queue full\n", fd);
+    markDirty(entry, fd);
+    return;
+  }
+  if (++entry->generation == 0) {
+    entry->generation = 1;
+  }
+  entry->registered = true;
+  entry->events = pollEvents(entry->channel);
+
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = entry->events;
+  sqe->user_data = pollToken(fd, entry->generation);
+  ++sqPending_;
+}
+
+// 无论取消能否立即提交，fd都视为没有生效的poll：旧poll的完成事件
+// 与表项不符会被忽略，fd被复用时新的channel也会重新提交
+void UringPoller::cancelPoll(ChannelEntry* entry, int fd) {
+  entry->registered = false;
+  entry->events = 0;
+  submitCancel(pollToken(fd, entry->generation));
+}
+
+// 提交队列满时留到下一轮重试，旧poll持有文件的引用，不取消会一直留在内核中
+void UringPoller::submitCancel(uint64_t token) {
+  io_uring_sqe* sqe = getSqe();
+  if (sqe == nullptr) {
+    LOG_ERROR("UringPoller::cancelPoll submission queue full\n");
+    pendingCancels_.push_back(token);
+    return;
+  }
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = token;
+  sqe->user_data = 0;  // 取消操作本身的完成事件直接忽略
+  ++sqPending_;
+}
+
+void UringPoller::fillActiveChannels(ChannelList* activeChannels) {
+  unsigned head = *cqHead_;
+  unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+
+  for (; head != tail; ++head) {
+    const io_uring_cqe& cqe = cqes_[head & *cqMask_];
+    if (cqe.user_data == 0) {
+      continue;
+    }
+    int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+    ChannelEntry* entry = findEntry(fd);
+    if (entry == nullptr || !entry->registered ||
+        pollToken(fd, entry->generation) != cqe.user_data) {
+      continue;  // 已被取消或重新提交过的poll
+    }
+    entry->registered = false;
+    entry->events = 0;
+    if (entry->channel == nullptr) {
+      continue;
+    }
+    // 一次性poll已触发，下一轮等待前重新提交
+    markDirty(entry, fd);
+    if (cqe.res < 0) {
+      LOG_ERROR("UringPoller poll fd=%d error:%d\n", fd, -cqe.res);
+      continue;
+    }
+    entry->channel->set_revents(cqe.res);
+    activeChannels->push_back(entry->channel);
+  }
+  __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
+
+}  // namespace Tnet
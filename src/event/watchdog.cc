@@ -0,0 +1,223 @@
+#include "event/watchdog.h"
+
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "event/channel.h"
+#include "event/eventloop.h"
+#include "util/log.h"
+
+namespace Tnet {
+
+static const int kMaxStackDepth = 64;
+
+Watchdog::Watchdog(double thresholdSeconds)
+    : thresholdUs_(static_cast<int64_t>(thresholdSeconds *
+                                        Timestamp::kMicroSecondsPerSecond)),
+      dumpStack_(true),
+      running_(false),
+      thread_(std::bind(&Watchdog::threadFunc, this), "Watchdog") {}
+
+Watchdog::~Watchdog() { stop(); }
+
+int Watchdog::stackSignal() { return SIGRTMIN + 5; }
+
+void Watchdog::watch(EventLoop* loop) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Watched watched;
+  watched.loop = loop;
+  watched.reportedSeq = 0;
+  loops_.push_back(watched);
+}
+
+void Watchdog::unwatch(EventLoop* loop) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  loops_.erase(std::remove_if(loops_.begin(), loops_.end(),
+                              [loop](const Watched& watched) {
+                                return watched.loop == loop;
+                              }),
+               loops_.end());
+}
+
+void Watchdog::start() {
+  if (dumpStack_) {
+    // backtrace第一次调用时会加载libgcc，提前调用一次，信号处理函数中不再分配内存
+    void* frames[1];
+    ::backtrace(frames, 1);
+
+    struct sigaction sa;
+    ::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = &Watchdog::handleStackSignal;
+    sa.sa_flags = SA_RESTART;
+    ::sigemptyset(&sa.sa_mask);
+    if (::sigaction(stackSignal(), &sa, nullptr) < 0) {
+      LOG_ERROR("Watchdog sigaction error:%d\n", errno);
+      dumpStack_ = false;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = true;
+  }
+  thread_.start();
+}
+
+void Watchdog::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+      return;
+    }
+    running_ = false;
+  }
+  cond_.notify_all();
+  thread_.join();
+}
+
+void Watchdog::threadFunc() {
+  // 检查间隔为阈值的四分之一，报告的延迟不超过阈值的1.25倍
+  std::chrono::microseconds interval(std::max<int64_t>(thresholdUs_ / 4, 1000));
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (running_) {
+    cond_.wait_for(lock, interval);
+    if (!running_) {
+      break;
+    }
+    int64_t nowUs = Timestamp::now().microSecondsSinceEpoch();
+    for (Watched& watched : loops_) {
+      check(&watched, nowUs);
+    }
+  }
+}
+
+void Watchdog::check(Watched* watched, int64_t nowUs) {
+  EventLoop* loop = watched->loop;
+  uint64_t seq = loop->callbackSeq_.load(std::memory_order_acquire);
+  int64_t startUs = loop->callbackStartUs_.load(std::memory_order_relaxed);
+  int fd = loop->callbackFd_.load(std::memory_order_relaxed);
+  char name[sizeof(loop->callbackName_)];
+  for (int i = 0; i < EventLoop::kCallbackNameWords; ++i) {
+    uint64_t word = loop->callbackName_[i].load(std::memory_order_relaxed);
+    ::memcpy(name + i * sizeof(word), &word, sizeof(word));
+  }
+  name[sizeof(name) - 1] = '\0';
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (loop->callbackSeq_.load(std::memory_order_relaxed) != seq) {
+    return;  // 读取期间回调已经切换，说明循环没有卡住
+  }
+  if (startUs == 0 || seq == watched->reportedSeq ||
+      nowUs - startUs < thresholdUs_) {
+    return;
+  }
+  watched->reportedSeq = seq;
+
+  double seconds =
+      static_cast<double>(nowUs - startUs) / Timestamp::kMicroSecondsPerSecond;
+  if (fd >= 0) {
+    LOG_WARN("Watchdog: EventLoop %p thread %d stalled %.3f s in callback of "
+             "fd=%d name=%s\n",
+             loop, loop->threadId_, seconds, fd, name);
+  } else {
+    LOG_WARN("Watchdog: EventLoop %p thread %d stalled %.3f s in pending "
+             "functors\n",
+             loop, loop->threadId_, seconds);
+  }
+  if (dumpStack_) {
+    ::syscall(SYS_tgkill, ::getpid(), loop->threadId_, stackSignal());
+  }
+}
+
+// 信号处理函数中使用的格式化：snprintf不是异步信号安全的，
+// 这里只做内存拷贝和整数转换
+class SignalSafeWriter {
+ public:
+  SignalSafeWriter() : len_(0) {}
+
+  void append(const char* data, size_t len) {
+    len = std::min(len, sizeof(buf_) - len_);
+    ::memcpy(buf_ + len_, data, len);
+    len_ += len;
+  }
+  void append(const char* str) { append(str, ::strlen(str)); }
+
+  void appendInt(int64_t value) {
+    char digits[24];
+    int n = 0;
+    uint64_t v = value < 0 ? 0 - static_cast<uint64_t>(value)
+                           : static_cast<uint64_t>(value);
+    do {
+      digits[n++] = static_cast<char>('0' + v % 10);
+      v /= 10;
+    } while (v != 0);
+    if (value < 0) {
+      digits[n++] = '-';
+    }
+    reverseAppend(digits, n);
+  }
+
+  void appendHex(uintptr_t value) {
+    static const char kHex[] = "0123456789abcdef";
+    char digits[2 * sizeof(uintptr_t)];
+    int n = 0;
+    do {
+      digits[n++] = kHex[value & 0xf];
+      value >>= 4;
+    } while (value != 0);
+    append("0x");
+    reverseAppend(digits, n);
+  }
+
+  void writeTo(int fd) {
+    ssize_t ret = ::write(fd, buf_, len_);
+    (void)ret;
+  }
+
+ private:
+  void reverseAppend(const char* digits, int n) {
+    while (n > 0 && len_ < sizeof(buf_)) {
+      buf_[len_++] = digits[--n];
+    }
+  }
+
+  char buf_[256];
+  size_t len_;
+};
+
+// 在卡住的循环线程中执行：此时正在执行的channel一定还活着，
+// 名字在卡顿期间不会被修改，直接读取其中的字节
+void Watchdog::handleStackSignal(int) {
+  int savedErrno = errno;
+  EventLoop* loop = EventLoop::loopOfCurrentThread();
+  Channel* channel = loop != nullptr
+                         ? loop->currentChannel_.load(std::memory_order_relaxed)
+                         : nullptr;
+
+  SignalSafeWriter writer;
+  writer.append("Watchdog: EventLoop ");
+  writer.appendHex(reinterpret_cast<uintptr_t>(loop));
+  if (channel != nullptr) {
+    const std::string& name = channel->name();
+    writer.append(" stalled in fd=");
+    writer.appendInt(channel->fd());
+    writer.append(" name=");
+    writer.append(name.data(), name.size());
+  } else {
+    writer.append(" stalled");
+  }
+  writer.append(", stack:\n");
+  writer.writeTo(STDERR_FILENO);
+
+  void* frames[kMaxStackDepth];
+  int depth = ::backtrace(frames, kMaxStackDepth);
+  ::backtrace_symbols_fd(frames, depth, STDERR_FILENO);
+  errno = savedErrno;
+}
+
+}  // namespace Tnet
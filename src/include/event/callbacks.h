@@ -16,11 +16,14 @@ class TcpConnection;
 class Timestamp;
 
 using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+using TimerCallback = std::function<void()>;
 using ConnectionCallback = std::function<void(const TcpConnectionPtr&)>;
 using CloseCallback = std::function<void(const TcpConnectionPtr&)>;
 using WriteCompleteCallback = std::function<void(const TcpConnectionPtr&)>;
 using HighWaterMarkCallback =
     std::function<void(const TcpConnectionPtr&, std::size_t)>;
+using LowWaterMarkCallback =
+    std::function<void(const TcpConnectionPtr&, std::size_t)>;
 
 using MessageCallback =
     std::function<void(const TcpConnectionPtr&, Buffer*, Timestamp)>;
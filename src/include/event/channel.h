@@ -2,6 +2,7 @@
 
 #include <functional>
 #include <memory>
+#include <string>
 
 #include "util/timestamp.h"
 
@@ -31,6 +32,10 @@ class Channel {
 
   int fd() const { return fd_; }
   int events() const { return events_; }
+
+  // channel所属对象的名字（如连接名），用于诊断信息
+  void setName(const std::string& name) { name_ = name; }
+  const std::string& name() const { return name_; }
   void set_revents(int revt) { revents_ = revt; }
 
   // 设置fd相应的事件状态
@@ -51,17 +56,26 @@ class Channel {
     update();
   }
   void disableAll() {
-    events_ = kNoneEvent;
+    events_ &= kEdgeEvent;
     update();
   }
 
+  // 边缘触发模式，在下一次update时生效，需要Poller支持
+  void setEdgeTriggered(bool on) {
+    if (on) {
+      events_ |= kEdgeEvent;
+    } else {
+      events_ &= ~kEdgeEvent;
+    }
+  }
+
   // 判断当前的状态
-  bool isNoneEvent() const { return events_ == kNoneEvent; }
+  bool isNoneEvent() const {
+    return (events_ & (kReadEvent | kWriteEvent)) == kNoneEvent;
+  }
   bool isWriting() const { return events_ & kWriteEvent; }
   bool isReading() const { return events_ & kReadEvent; }
-
-  int index() { return index_; }
-  void set_index(int idx) { index_ = idx; }
+  bool isEdgeTriggered() const { return events_ & kEdgeEvent; }
 
   // one loop per thread
   EventLoop* ownerLoop() { return loop_; }
@@ -79,12 +93,13 @@ class Channel {
   static const int kNoneEvent;
   static const int kReadEvent;
   static const int kWriteEvent;
+  static const int kEdgeEvent;
 
   EventLoop* loop_;  // 事件循环
   const int fd_;     // fd，Poller监听的对象
   int events_;       // 注册fd感兴趣的事件
   int revents_;      // Poller返回的具体发生的事件
-  int index_;
+  std::string name_;
 
   std::weak_ptr<void> tie_;
   bool tied_;
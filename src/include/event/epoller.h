@@ -9,6 +9,9 @@ namespace Tnet {
 
 class Channel;
 
+// 基于epoll的Poller。
+// 一轮循环中对channel关注事件的修改只记录在dirtyFds_中，下一次epoll_wait前
+// 统一提交，同一fd在一轮中多次修改最多只产生一次epoll_ctl。
 class Epoller : public Poller {
  public:
   Epoller(EventLoop *loop);
@@ -17,6 +20,7 @@ class Epoller : public Poller {
   Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
   void updateChannel(Channel *channel) override;
   void removeChannel(Channel *channel) override;
+  bool edgeTriggeredSupported() const override { return true; }
 
  private:
   static const int kInitEventListSize = 16;
@@ -24,10 +28,15 @@ class Epoller : public Poller {
   void fillActiveChannels(int numEvents, ChannelList *activeChannels) const;
   void update(int operation, Channel *channel);
 
+  void markDirty(ChannelEntry *entry, int fd);
+  void flushDirty();
+
   using EventList = std::vector<epoll_event>;
 
   int epollfd_;
   EventList events_;
+
+  std::vector<int> dirtyFds_;  // 需要在下次等待前提交的fd
 };
 
 }  // namespace Tnet
\ No newline at end of file
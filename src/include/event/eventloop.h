@@ -3,22 +3,33 @@
 #include <atomic>
 #include <functional>
 #include <memory>
-#include <mutex>
+#include <string>
 #include <vector>
 
+#include "event/callbacks.h"
+#include "event/loopstats.h"
+#include "event/timer.h"
 #include "thread/curthread.h"
+#include "util/inplacefunction.h"
 #include "util/macros.h"
+#include "util/mpscqueue.h"
 #include "util/timestamp.h"
 
 namespace Tnet {
 
 class Channel;
 class Poller;
+class TimerQueue;
+class TimingWheel;
+class Watchdog;
 
 // 代表所有I/O事件被处理的事件循环。
 class EventLoop {
   public:
-  using Functor = std::function<void()>;
+  /// 捕获不超过kFunctorInlineSize字节的回调（如绑定一个shared_ptr与成员函数，
+  /// 或再加一个std::function/std::string）不会分配内存。
+  static const size_t kFunctorInlineSize = 64;
+  using Functor = InplaceFunction<void(), kFunctorInlineSize>;
 
   EventLoop();
   ~EventLoop();
@@ -29,18 +40,86 @@ class EventLoop {
 
   Timestamp pollReturnTime() const { return pollReturnTime_; }
 
+  /// loop()是否正在运行，线程安全。
+  bool looping() const { return looping_.load(std::memory_order_acquire); }
+
+  /// 忙轮询模式：阻塞poll之前先以零超时poll自旋budgetUs微秒，
+  /// 用一个CPU核换取更低的唤醒延迟。0表示关闭。
+  /// 需要在loop()之前（例如ThreadInitCallback中）或循环线程中设置。
+  void setBusyPoll(int64_t budgetUs) { busyPollUs_ = budgetUs; }
+  int64_t busyPollUs() const { return busyPollUs_; }
+
   /// 在当前循环中执行一个回调。
   void runInLoop(Functor cb);
 
   /// 将回调函数加入循环队列并唤醒循环。
   void queueInLoop(Functor cb);
 
+  /// 在本轮循环的事件和队列回调都处理完之后执行回调，只能在循环线程中调用。
+  /// 用于把一轮循环中的多次操作合并成一次，例如TcpConnection的合并发送。
+  void runAtIterationEnd(Functor cb);
+
   /// 唤醒循环的线程。
   void wakeup();
 
+  /// 当前等待执行的回调数量，可在任意线程读取。
+  std::size_t queueSize() const {
+    return pendingCount_.load(std::memory_order_relaxed);
+  }
+  /// 等待执行的回调数量的历史最大值。
+  std::size_t maxQueueSize() const {
+    return maxPendingCount_.load(std::memory_order_relaxed);
+  }
+  /// 实际写入eventfd的唤醒次数。
+  uint64_t wakeupCount() const {
+    return wakeupCount_.load(std::memory_order_relaxed);
+  }
+
+  /// 本循环的运行统计快照（poll等待、事件分发、回调队列），线程安全。
+  LoopStats stats() const { return stats_.snapshot(); }
+
+  /// 最近约一秒内循环忙于处理回调（而不是等待在poll中）的时间比例，
+  /// 取值0~1，线程安全。
+  double utilization() const {
+    return utilizationPpm_.load(std::memory_order_relaxed) / 1e6;
+  }
+
+  /// 归属本循环的连接数，由TcpConnection在构造和析构时维护，线程安全。
+  int connectionCount() const {
+    return connectionCount_.load(std::memory_order_relaxed);
+  }
+  void incConnectionCount() {
+    connectionCount_.fetch_add(1, std::memory_order_relaxed);
+  }
+  void decConnectionCount() {
+    connectionCount_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  /// 本循环共享的读缓冲区：连接读事件先读到这里，交给消息回调处理，
+  /// 回调没有消费完的数据才拷贝到连接自己的输入缓冲区。只能在循环线程中使用。
+  static const size_t kReadScratchSize = 256 * 1024;
+  char* readScratch() { return readScratch_.get(); }
+
+  /// 在time时刻执行回调，线程安全。
+  TimerId runAt(Timestamp time, TimerCallback cb);
+  /// 在delay秒之后执行回调，线程安全。
+  TimerId runAfter(double delay, TimerCallback cb);
+  /// 每隔interval秒执行一次回调，线程安全。
+  TimerId runEvery(double interval, TimerCallback cb);
+  /// 取消定时器，线程安全。
+  void cancel(TimerId timerId);
+
+  /// 本循环的时间轮，用于大量可频繁重置的超时（如连接空闲超时）。
+  /// 只能在循环线程中使用。
+  TimingWheel* timingWheel() { return timingWheel_.get(); }
+
   void updateChannel(Channel* channel);
   void removeChannel(Channel* channel);
   bool hasChannel(Channel* channel);
+  bool edgeTriggeredSupported() const;
+
+  /// 当前线程的EventLoop，没有则返回nullptr。
+  static EventLoop* loopOfCurrentThread();
 
   /// 判断EventLoop对象是否在它自己的线程中。
   bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
@@ -52,9 +131,24 @@ class EventLoop {
   }
 
   private:
+  friend class Watchdog;
+
   void abortNotInLoopThread();
   void handleRead();         // 处理来自唤醒文件描述符的读事件。
-  void doPendingFunctors();  // 执行队列中的回调。
+  std::size_t doPendingFunctors();  // 执行队列中的回调，返回执行的数量。
+  std::size_t doIterationEndFunctors();  // 执行本轮循环末尾的回调。
+
+  struct PendingTask;  // 队列节点，包装一个Functor
+
+  PendingTask* newTask(Functor cb);
+  void freeTask(PendingTask* task);
+  bool busyPoll();           // 忙轮询，返回是否有待处理的事件。
+
+  // 记录正在执行的回调，channel为nullptr表示队列中的回调
+  void beginCallback(Timestamp start, Channel* channel);
+  void endCallback();
+  void publishCallbackName(const std::string& name);
+  void updateUtilization(const LoopSample& sample);
 
   using ChannelList = std::vector<Channel*>;
 
@@ -65,15 +159,44 @@ class EventLoop {
 
   Timestamp pollReturnTime_;        // 最后一次poll调用返回的时间。
   std::unique_ptr<Poller> poller_;  // 本循环使用的Poller实例。
+  std::unique_ptr<TimerQueue> timerQueue_;  // 由timerfd驱动的定时器队列。
+  std::unique_ptr<TimingWheel> timingWheel_;  // 由timerQueue_驱动的时间轮。
 
   int wakeupFd_;  // 用于唤醒循环的文件描述符。
   std::unique_ptr<Channel> wakeupChannel_;  // 唤醒文件描述符的通道。
 
   ChannelList activeChannels_;  // 有待处理事件的通道列表。
 
-  std::atomic<bool> callingPendingFunctors_;  // 如果有待执行的回调，则为真。
-  std::vector<Functor> pendingFunctors_;  // 要执行的队列回调。
-  std::mutex mutex_;  // 保护`pendingFunctors`访问的互斥锁。
+  MpscQueue<PendingTask> pendingFunctors_;  // 要执行的队列回调，无锁。
+  std::atomic<std::size_t> pendingCount_;     // 队列中回调的数量。
+  std::atomic<std::size_t> maxPendingCount_;  // 队列深度的历史最大值。
+  std::atomic<bool> sleeping_;  // 循环是否（即将）阻塞在poll中。
+  std::atomic<uint64_t> wakeupCount_;  // 写eventfd的次数。
+  // 预分配的队列节点与空闲链表。任意线程都可以从链表取节点，循环线程执行完后放回。
+  // 链表头是(版本号 << 32 | 节点下标)，每次修改版本号加一，避免CAS的ABA问题
+  std::unique_ptr<PendingTask[]> taskPool_;
+  std::atomic<uint64_t> freeTaskHead_;
+  std::vector<Functor> iterationEndFunctors_;  // 本轮循环末尾执行的回调。
+  std::vector<Functor> runningIterationEnd_;   // 正在执行的，复用容量。
+
+  int64_t busyPollUs_;  // 忙轮询的自旋预算（微秒），0表示关闭。
+
+  LoopStatsRecorder stats_;  // 每轮循环的统计。
+  double utilization_;       // 利用率的指数滑动平均，只在循环线程中访问。
+  std::atomic<uint32_t> utilizationPpm_;  // 发布给其他线程的利用率（百万分比）。
+  std::atomic<int> connectionCount_;      // 归属本循环的连接数。
+
+  // 正在执行的回调，供Watchdog在其他线程中检查
+  std::atomic<uint64_t> callbackSeq_;     // 每开始/结束一个回调加一
+  std::atomic<int64_t> callbackStartUs_;  // 回调开始的时间，0表示空闲
+  std::atomic<int> callbackFd_;           // 回调所属的fd，-1表示队列回调
+  std::atomic<Channel*> currentChannel_;  // 只在循环线程中解引用
+  // 回调所属channel名字的快照，以'\0'结尾，过长时截断。
+  // 按字存放，Watchdog与callbackSeq_一起读取，不会读到正在改写的名字
+  static const int kCallbackNameWords = 8;
+  std::atomic<uint64_t> callbackName_[kCallbackNameWords];
+
+  std::unique_ptr<char[]> readScratch_;  // 所有连接共享的读缓冲区
 };
 
 }  // namespace Tnet
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "util/macros.h"
+
+namespace Tnet {
+
+// 以2的幂划分桶的直方图：0单独一个桶，第i个桶统计[2^(i-1), 2^i)内的值
+struct Histogram {
+  static const int kBuckets = 32;
+
+  Histogram();
+
+  void add(uint64_t value);
+
+  double mean() const {
+    return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+  }
+  // 第p（0~1）分位数所在桶的上界
+  uint64_t percentile(double p) const;
+
+  static int bucketOf(uint64_t value);
+
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint64_t buckets[kBuckets];
+};
+
+// EventLoop运行统计的一份快照
+struct LoopStats {
+  uint64_t iterations;             // 循环的轮数
+  Histogram pollWaitUs;            // 每轮阻塞在poll中的时间（微秒）
+  Histogram eventsPerIteration;    // 每轮poll返回的活跃channel数
+  Histogram dispatchUs;            // 每轮handleEvent回调的总耗时（微秒）
+  Histogram functorsPerIteration;  // 每轮执行的队列回调与末尾回调数
+  Histogram functorUs;             // 每轮doPendingFunctors的总耗时（微秒）
+};
+
+// 一轮循环的采样
+struct LoopSample {
+  uint64_t pollWaitUs;
+  uint64_t events;
+  uint64_t dispatchUs;
+  uint64_t functors;
+  uint64_t functorUs;
+};
+
+// 由循环线程写入、任意线程读取的统计。
+// 写入只有循环线程一个，用seqlock保证读到的快照是某一轮结束时的完整状态，
+// 写入方不加锁也不做原子读改写，每轮只多几次普通的store。
+class LoopStatsRecorder {
+ public:
+  LoopStatsRecorder();
+
+  DISALLOW_COPY(LoopStatsRecorder)
+
+  // 只能在循环线程中调用
+  void record(const LoopSample& sample);
+  // 线程安全
+  LoopStats snapshot() const;
+
+ private:
+  class AtomicHistogram {
+   public:
+    AtomicHistogram();
+
+    void add(uint64_t value);
+    void load(Histogram* out) const;
+
+   private:
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+    std::atomic<uint64_t> buckets_[Histogram::kBuckets];
+  };
+
+  std::atomic<uint64_t> seq_;  // 奇数表示正在写入
+  std::atomic<uint64_t> iterations_;
+  AtomicHistogram pollWaitUs_;
+  AtomicHistogram eventsPerIteration_;
+  AtomicHistogram dispatchUs_;
+  AtomicHistogram functorsPerIteration_;
+  AtomicHistogram functorUs_;
+};
+
+}  // namespace Tnet
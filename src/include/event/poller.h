@@ -1,6 +1,7 @@
 #pragma once
 
-#include <unordered_map>
+#include <stdint.h>
+
 #include <vector>
 
 #include "util/macros.h"
@@ -26,14 +27,64 @@ class Poller {
   // 判断参数channel是否在当前的Poller当中
   bool hasChannel(Channel* channel) const;
 
+  // 是否支持Channel的边缘触发模式
+  virtual bool edgeTriggeredSupported() const { return false; }
+
   void assertInLoopThread() const { ownerLoop_->assertInLoopThread(); }
 
   protected:
-  // map的key:sockfd value:sockfd所属的channel通道类型
-  using ChannelMap = std::unordered_map<int, Channel*>;
-  ChannelMap channels_;
+  // channel在Poller中的注册状态
+  enum ChannelState {
+    kNew,      // 还没添加至Poller
+    kAdded,    // 已经添加至Poller，内核正在监听
+    kDeleted,  // 仍在Poller中，但内核已不再监听（没有关注的事件）
+  };
+
+  // 以fd为下标的表项。channel与state描述Poller中的注册状态，
+  // 其余字段由具体的Poller记录fd在内核中的状态，removeChannel后仍然保留
+  struct ChannelEntry {
+    ChannelEntry()
+        : channel(nullptr),
+          state(kNew),
+          events(0),
+          generation(0),
+          registered(false),
+          dirty(false) {}
+
+    Channel* channel;
+    ChannelState state;
+    uint32_t events;      // 已提交给内核的监听事件
+    uint32_t generation;  // UringPoller用来区分同一fd上过期的完成事件
+    bool registered;      // fd是否已在内核中注册
+    bool dirty;           // 是否在等待下次poll前提交
+  };
+
+  // updateChannel中各Poller共用的状态转换：新的或已删除的channel变为kAdded，
+  // 不再关注任何事件的变为kDeleted。返回fd的表项，由调用者提交到内核
+  ChannelEntry& updateEntry(Channel* channel);
+  // removeChannel中共用的部分：把channel移出表，返回其表项以便从内核中删除。
+  // channel从未添加至Poller时返回nullptr
+  ChannelEntry* removeEntry(Channel* channel);
+
+  // fd超出表的范围时返回nullptr
+  ChannelEntry* findEntry(int fd) {
+    return static_cast<size_t>(fd) < channels_.size() ? &channels_[fd]
+                                                      : nullptr;
+  }
+  const ChannelEntry* findEntry(int fd) const {
+    return static_cast<size_t>(fd) < channels_.size() ? &channels_[fd]
+                                                      : nullptr;
+  }
+
+  // fd是较小的稠密整数，直接以fd为下标，表项中同时记录注册状态
+  using ChannelTable = std::vector<ChannelEntry>;
+  ChannelTable channels_;
+  size_t numChannels_;
 
   private:
+  // 取fd对应的表项，表不够大时扩容
+  ChannelEntry& channelEntry(int fd);
+
   EventLoop* ownerLoop_;  // 定义Poller所属的事件循环EventLoop
 };
 
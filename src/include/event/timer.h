@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "event/callbacks.h"
+#include "util/macros.h"
+#include "util/timestamp.h"
+
+namespace Tnet {
+
+// 定时器，记录到期时间、回调以及重复间隔
+class Timer {
+ public:
+  Timer(TimerCallback cb, Timestamp when, double interval)
+      : callback_(std::move(cb)),
+        expiration_(when),
+        interval_(interval),
+        repeat_(interval > 0.0),
+        sequence_(++s_numCreated_) {}
+
+  DISALLOW_COPY(Timer)
+
+  void run() const { callback_(); }
+
+  Timestamp expiration() const { return expiration_; }
+  bool repeat() const { return repeat_; }
+  int64_t sequence() const { return sequence_; }
+
+  // 重复定时器以now为基准计算下一次到期时间
+  void restart(Timestamp now);
+
+  static int64_t numCreated() { return s_numCreated_; }
+
+ private:
+  const TimerCallback callback_;
+  Timestamp expiration_;
+  const double interval_;  // 重复间隔，单位秒
+  const bool repeat_;
+  const int64_t sequence_;  // 全局唯一序号，区分地址复用的Timer
+
+  static std::atomic<int64_t> s_numCreated_;
+};
+
+// 对外暴露的定时器句柄，用于取消定时器
+class TimerId {
+ public:
+  TimerId() : timer_(nullptr), sequence_(0) {}
+  TimerId(Timer* timer, int64_t seq) : timer_(timer), sequence_(seq) {}
+
+  friend class TimerQueue;
+
+ private:
+  Timer* timer_;
+  int64_t sequence_;
+};
+
+}  // namespace Tnet
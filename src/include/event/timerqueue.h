@@ -0,0 +1,63 @@
+#pragma once
+
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "event/callbacks.h"
+#include "event/channel.h"
+#include "util/macros.h"
+#include "util/timestamp.h"
+
+namespace Tnet {
+
+class EventLoop;
+class Timer;
+class TimerId;
+
+// 每个EventLoop拥有一个TimerQueue，由timerfd驱动。
+// 定时器按到期时间有序存放，插入与取消为O(log n)，
+// 每次timerfd可读时批量处理所有已到期的定时器。
+class TimerQueue {
+ public:
+  explicit TimerQueue(EventLoop* loop);
+  ~TimerQueue();
+
+  DISALLOW_COPY(TimerQueue)
+
+  // 线程安全，可以在其他线程调用
+  TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+
+  // 线程安全，可以在其他线程调用
+  void cancel(TimerId timerId);
+
+ private:
+  using Entry = std::pair<Timestamp, Timer*>;
+  using TimerList = std::set<Entry>;
+  using ActiveTimer = std::pair<Timer*, int64_t>;
+  using ActiveTimerSet = std::set<ActiveTimer>;
+
+  void addTimerInLoop(Timer* timer);
+  void cancelInLoop(TimerId timerId);
+
+  // timerfd 可读时的回调
+  void handleRead();
+
+  // 取出所有已到期的定时器
+  std::vector<Entry> getExpired(Timestamp now);
+  void reset(const std::vector<Entry>& expired, Timestamp now);
+
+  bool insert(Timer* timer);
+
+  EventLoop* loop_;
+  const int timerfd_;
+  Channel timerfdChannel_;
+
+  TimerList timers_;  // 按到期时间排序
+
+  ActiveTimerSet activeTimers_;  // 按Timer地址排序，与timers_保存相同的定时器
+  bool callingExpiredTimers_;
+  ActiveTimerSet cancelingTimers_;  // 回调执行期间被取消的定时器
+};
+
+}  // namespace Tnet
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "event/callbacks.h"
+#include "event/timer.h"
+#include "util/macros.h"
+#include "util/timestamp.h"
+
+namespace Tnet {
+
+class EventLoop;
+class TimingWheel;
+class WheelTimer;
+
+// 侵入式双向链表节点，时间轮的每个槽位是一个哨兵节点
+struct WheelLink {
+  explicit WheelLink(WheelTimer* o = nullptr)
+      : prev(this), next(this), owner(o) {}
+
+  bool empty() const { return next == this; }
+
+  WheelLink* prev;
+  WheelLink* next;
+  WheelTimer* owner;  // 哨兵节点为nullptr
+};
+
+// 挂在时间轮上的定时器，由使用者持有（例如TcpConnection的成员），
+// 重新设置或取消都只是链表操作，不会分配内存
+class WheelTimer {
+ public:
+  explicit WheelTimer(TimerCallback cb = TimerCallback())
+      : link_(this), wheel_(nullptr), expire_(0), callback_(std::move(cb)) {}
+  ~WheelTimer();
+
+  DISALLOW_COPY(WheelTimer)
+
+  void setCallback(TimerCallback cb) { callback_ = std::move(cb); }
+
+  // 是否已挂在时间轮上
+  bool armed() const { return wheel_ != nullptr; }
+
+ private:
+  friend class TimingWheel;
+
+  void unlink() {
+    link_.prev->next = link_.next;
+    link_.next->prev = link_.prev;
+    link_.prev = link_.next = &link_;
+  }
+
+  WheelLink link_;
+  TimingWheel* wheel_;  // 当前挂载的时间轮
+  uint64_t expire_;  // 到期的tick
+  TimerCallback callback_;
+};
+
+// 分层时间轮（1个256槽的根层 + 3个64槽的上层），
+// arm/cancel均为O(1)，由EventLoop的TimerQueue按固定精度驱动。
+// 只能在所属EventLoop的线程中使用。
+class TimingWheel {
+ public:
+  explicit TimingWheel(EventLoop* loop, double tickSeconds = kDefaultTick);
+  ~TimingWheel();
+
+  DISALLOW_COPY(TimingWheel)
+
+  // 在timeout秒后触发timer，若timer已挂在时间轮上则重新计时
+  void arm(WheelTimer* timer, double timeout);
+  void cancel(WheelTimer* timer);
+
+  std::size_t size() const { return size_; }
+  double tickSeconds() const { return tick_; }
+
+  static constexpr double kDefaultTick = 0.1;  // 100毫秒
+
+ private:
+  static const int kRootBits = 8;
+  static const int kLevelBits = 6;
+  static const int kLevels = 4;
+  static const uint64_t kRootSize = 1 << kRootBits;
+  static const uint64_t kLevelSize = 1 << kLevelBits;
+  static const uint64_t kRootMask = kRootSize - 1;
+  static const uint64_t kLevelMask = kLevelSize - 1;
+  static const uint64_t kMaxTicks =
+      (uint64_t(1) << (kRootBits + (kLevels - 1) * kLevelBits)) - 1;
+
+  void link(WheelTimer* timer);
+  void cascade(int level, uint64_t index);
+  void advance();
+  void handleTick();  // 定时器回调，按流逝的时间推进时间轮
+  void startTicking();
+  void stopTicking();
+
+  EventLoop* loop_;
+  const double tick_;
+  uint64_t current_;  // 下一个要处理的tick
+  std::size_t size_;
+
+  bool ticking_;
+  Timestamp lastTick_;
+  TimerId tickTimer_;
+
+  WheelLink root_[kRootSize];
+  WheelLink levels_[kLevels - 1][kLevelSize];
+};
+
+}  // namespace Tnet
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <linux/io_uring.h>
+
+#include <vector>
+
+#include "poller.h"
+#include "util/timestamp.h"
+
+namespace Tnet {
+
+class Channel;
+
+// 基于io_uring的Poller。
+// 每个fd使用一次性的IORING_OP_POLL_ADD监听，触发后在下一轮重新提交，
+// 因此保持与Epoller相同的水平触发语义。一轮循环中所有的poll注册、
+// 取消以及等待只需要一次io_uring_enter。
+class UringPoller : public Poller {
+ public:
+  UringPoller(EventLoop *loop);
+  ~UringPoller() override;
+
+  // 当前内核是否支持本实现所需的io_uring特性
+  bool valid() const { return ringfd_ >= 0; }
+
+  Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
+  void updateChannel(Channel *channel) override;
+  void removeChannel(Channel *channel) override;
+
+ private:
+  static const unsigned kRingEntries = 1024;
+
+  bool setupRing();
+  io_uring_sqe *getSqe();
+  int enter(unsigned minComplete, unsigned flags, int timeoutMs);
+
+  void markDirty(ChannelEntry *entry, int fd);
+  void flushDirty();
+  void armPoll(ChannelEntry *entry, int fd);
+  void cancelPoll(ChannelEntry *entry, int fd);
+  void submitCancel(uint64_t token);
+  void fillActiveChannels(ChannelList *activeChannels);
+
+  int ringfd_;
+
+  // 提交队列
+  void *sqRing_;
+  size_t sqRingSize_;
+  unsigned *sqHead_;
+  unsigned *sqTail_;
+  unsigned *sqMask_;
+  unsigned *sqArray_;
+  io_uring_sqe *sqes_;
+  size_t sqesSize_;
+  unsigned sqPending_;  // 已填写但尚未发布给内核的sqe数量
+
+  // 完成队列
+  void *cqRing_;
+  size_t cqRingSize_;
+  unsigned *cqHead_;
+  unsigned *cqTail_;
+  unsigned *cqMask_;
+  io_uring_cqe *cqes_;
+
+  std::vector<int> dirtyFds_;  // 需要在下次等待前重新提交poll的fd
+  std::vector<uint64_t> pendingCancels_;  // 提交队列满时未能提交的取消
+};
+
+}  // namespace Tnet
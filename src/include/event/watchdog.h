@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "thread/thread.h"
+#include "util/macros.h"
+
+namespace Tnet {
+
+class EventLoop;
+
+// 检测EventLoop卡顿的看门狗。
+// 独立线程定期检查被监视的循环，某个回调执行超过阈值时报告所在的循环、
+// channel的fd与名字（连接名），并可让卡住的线程把自己的调用栈打印到stderr。
+// 被监视的EventLoop析构前必须先unwatch。
+class Watchdog {
+ public:
+  explicit Watchdog(double thresholdSeconds = 1.0);
+  ~Watchdog();
+
+  DISALLOW_COPY(Watchdog)
+
+  // 卡顿时是否向循环线程发送信号打印调用栈，默认打开，需要在start之前设置。
+  // 信号会打断回调中正在进行的、不会自动重启的阻塞调用（如sleep）。
+  void setDumpStack(bool on) { dumpStack_ = on; }
+
+  // 线程安全
+  void watch(EventLoop* loop);
+  void unwatch(EventLoop* loop);
+
+  void start();
+  void stop();
+
+  // 打印调用栈使用的信号
+  static int stackSignal();
+
+ private:
+  struct Watched {
+    EventLoop* loop;
+    uint64_t reportedSeq;  // 已经报告过的回调，避免同一次卡顿重复报告
+  };
+
+  void threadFunc();
+  void check(Watched* watched, int64_t nowUs);
+  static void handleStackSignal(int sig);
+
+  const int64_t thresholdUs_;
+  bool dumpStack_;
+  bool running_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::vector<Watched> loops_;
+  Thread thread_;
+};
+
+}  // namespace Tnet
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <map>
+#include <string>
+
 #include "tcpserver/tcpserver.h"
 
 namespace google {
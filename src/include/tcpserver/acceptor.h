@@ -1,16 +1,52 @@
 #pragma once
 
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
 #include <functional>
 
 #include "event/channel.h"
 #include "util/macros.h"
 #include "tcpserver/socket.h"
 #include "event/eventloop.h"
+#include "tcpserver/inetaddress.h"
 
 namespace Tnet {
 
 class EventLoop;
-class InetAddress;
+
+// Acceptor的统计，计数器单调递增，可据此计算accept速率
+struct AcceptStats {
+  AcceptStats()
+      : accepted(0),
+        rejected(0),
+        batchFull(0),
+        listenOverflows(0),
+        listenDrops(0),
+        acceptQueue(0) {}
+
+  uint64_t accepted;   // 成功accept并交给回调的连接数
+  uint64_t rejected;   // fd耗尽时accept后立即关闭的连接数
+  uint64_t batchFull;  // 一次可读事件用满批量上限的次数，说明accept跟不上
+  // 全连接队列溢出而被内核丢弃的连接数（/proc/net/netstat的TcpExt
+  // ListenOverflows/ListenDrops）。这是整个主机（网络命名空间）的计数器，
+  // 包括本进程之外的监听socket，不是某个监听socket的，读不到时为0
+  uint64_t listenOverflows;
+  uint64_t listenDrops;
+  int acceptQueue;  // 当前在全连接队列中等待accept的连接数，不是计数器
+
+  AcceptStats& operator+=(const AcceptStats& other) {
+    accepted += other.accepted;
+    rejected += other.rejected;
+    batchFull += other.batchFull;
+    // 主机级别的计数器，读到的是同一个值，不能累加
+    listenOverflows = std::max(listenOverflows, other.listenOverflows);
+    listenDrops = std::max(listenDrops, other.listenDrops);
+    acceptQueue += other.acceptQueue;
+    return *this;
+  }
+};
 
 class Acceptor {
  public:
@@ -26,16 +62,40 @@ class Acceptor {
     NewConnectionCallback_ = cb;
   }
 
+  // 每次可读事件最多accept的连接数，需要在listen之前设置
+  void setAcceptBatch(int batch) { acceptBatch_ = batch > 0 ? batch : 1; }
+  int acceptBatch() const { return acceptBatch_; }
+
   bool listenning() const { return listenning_; }
   void listen();
 
+  // 实际绑定的地址，端口为0时由内核分配
+  InetAddress listenAddress() const;
+
+  // 本Acceptor的统计，线程安全。不读取主机级别的listenOverflows与
+  // listenDrops，需要时调用readListenOverflows
+  AcceptStats stats() const;
+
+  // 从/proc/net/netstat读取主机级别的ListenOverflows与ListenDrops。
+  // 所有监听socket共用同一组计数器，多个Acceptor只需要读一次
+  static void readListenOverflows(AcceptStats* stats);
+
  private:
+  static const int kDefaultAcceptBatch = 16;
+
   void handleRead();
+  bool rejectOne();  // 返回是否腾出预留fd拒绝掉了一个连接
 
   EventLoop *loop_;
   Socket acceptSocket_;
   Channel acceptChannel_;
   NewConnectionCallback NewConnectionCallback_;
   bool listenning_;
+  int acceptBatch_;
+  int idleFd_;  // fd耗尽时腾出一个位置来accept并关闭多余的连接
+
+  std::atomic<uint64_t> acceptedCount_;
+  std::atomic<uint64_t> rejectedCount_;
+  std::atomic<uint64_t> batchFullCount_;
 };
 }  // namespace Tnet
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "event/timer.h"
 #include "tcpserver/inetaddress.h"
 #include "util/macros.h"
 
@@ -51,5 +52,6 @@ class Connector : public std::enable_shared_from_this<Connector> {
   std::unique_ptr<Channel> channel_;
   NewConnectionCallback newConnectionCallback_;
   int retryDelayMs_;
+  TimerId retryTimer_;
 };
 }  // namespace Tnet
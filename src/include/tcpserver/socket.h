@@ -25,6 +25,13 @@ class Socket {
   void setReuseAddr(bool on);
   void setReusePort(bool on);
   void setKeepAlive(bool on);
+  // SO_BUSY_POLL/SO_PREFER_BUSY_POLL，usec为0表示关闭
+  void setBusyPoll(int usec);
+  // SO_ZEROCOPY，之后才能使用MSG_ZEROCOPY发送，内核不支持时返回false
+  bool setZeroCopy(bool on);
+  // TCP_NOTSENT_LOWAT：内核中未发出的数据低于bytes时socket才可写，
+  // 0表示使用sysctl net.ipv4.tcp_notsent_lowat的值
+  void setNotSentLowat(unsigned int bytes);
 
   static int getSocketError(int sockfd);
   static bool isSelfConnect(int sockfd);
@@ -1,13 +1,20 @@
 #pragma once
 
+#include <sys/types.h>
+
 #include <atomic>
+#include <deque>
 #include <memory>
 #include <string>
 
 #include "event/callbacks.h"
+#include "event/timingwheel.h"
 #include "tcpserver/inetaddress.h"
 #include "util/buffer.h"
+#include "util/chainbuffer.h"
 #include "util/macros.h"
+#include "util/mpscqueue.h"
+#include "util/slice.h"
 #include "util/timestamp.h"
 
 #include <boost/any.hpp>
@@ -33,9 +40,30 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
 
   bool connected() const { return state_ == kConnected; }
 
-  // 发送数据
+  // 发送数据，可以在任意线程调用。在其他线程调用时数据进入连接的
+  // 无锁发送队列，由所属循环按序发出，同一线程的send、sendZeroCopy、
+  // sendFile之间保持调用顺序：右值版本直接转移所有权，不拷贝；
+  // const引用版本拷贝一份；Buffer*版本转移其中的数据并清空buf
   void send(const std::string& buf);
+  void send(std::string&& message);
   void send(Buffer* message);
+  void send(Buffer&& message);
+  // 发送不可变的共享数据，只增加引用计数，适合同一条消息广播给大量连接
+  void send(const Slice& slice);
+  // 零拷贝发送：负载以MSG_ZEROCOPY直接从payload的内存发出，
+  // 省去拷贝到输出缓冲区和内核socket缓冲区的两次拷贝。payload会一直被持有，
+  // 直到从socket错误队列收到内核的完成通知。小于kZeroCopyThreshold、
+  // 内核不支持或内核报告实际仍需拷贝（如回环地址）时退化为普通send
+  using ZeroCopyPayload = std::shared_ptr<const std::string>;
+  static const std::size_t kZeroCopyThreshold = 64 * 1024;
+  void sendZeroCopy(ZeroCopyPayload payload);
+  // 用sendfile发送文件fd中从offset开始的length字节，数据不经过用户态。
+  // 与之前send的数据保持顺序，socket写满时由写事件继续发送。
+  // fd会被dup，调用者之后可以立即关闭自己的fd。fd必须是普通文件，
+  // 否则不发送；发送途中读文件出错时关闭连接
+  void sendFile(int fd, off_t offset, std::size_t length);
+  // 立即发出输出缓冲区中积压的数据（合并发送模式下不必等到本轮循环结束）
+  void flush();
   // 关闭连接
   void shutdown();
   void forceClose();
@@ -60,6 +88,69 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
     highWaterMarkCallback_ = cb;
     highWaterMark_ = highWaterMark;
   }
+  // 待发送数据越过高水位后又降到lowWaterMark及以下时回调一次，
+  // 与高水位回调配对，生产者可以据此暂停和恢复发送
+  void setLowWaterMarkCallback(const LowWaterMarkCallback& cb,
+                               std::size_t lowWaterMark) {
+    lowWaterMarkCallback_ = cb;
+    lowWaterMark_ = lowWaterMark;
+  }
+
+  // 超过输出上限时的处理方式
+  enum OutputOverflowPolicy {
+    kDropSend,        // 丢弃这次send的整条消息
+    kCloseConnection  // 关闭连接，踢掉跟不上的慢速对端
+  };
+  // 待发送数据的硬上限：一次send会使待发送数据超过maxBytes时按policy处理，
+  // 消息要么完整进入输出队列，要么整条丢弃，不会截断。0表示不限制。
+  // maxBytes应大于单条消息的最大长度。需要在循环线程中设置
+  void setOutputLimit(std::size_t maxBytes,
+                      OutputOverflowPolicy policy = kDropSend) {
+    outputLimit_ = maxBytes;
+    outputOverflowPolicy_ = policy;
+  }
+  // 因超过输出上限而丢弃的send次数
+  std::size_t droppedSends() const { return droppedSends_; }
+  // 尚未写入socket的字节数，包括输出缓冲区、零拷贝负载和文件，
+  // 不包括其他线程还在发送队列中的数据。只能在循环线程中调用
+  std::size_t pendingOutputBytes() const;
+
+  // TCP_NOTSENT_LOWAT：内核中未发出的数据低于bytes时才报告可写，
+  // 数据留在用户态的输出缓冲区，水位回调和输出上限看到的积压量更真实，
+  // 也减少了socket缓冲区的内存占用。
+  // 0表示恢复为sysctl net.ipv4.tcp_notsent_lowat的设置
+  void setNotSentLowat(unsigned int bytes);
+
+  // 暂停/恢复读取，线程安全。暂停期间对端的数据留在内核接收缓冲区，
+  // 接收窗口随之缩小，由TCP流控反压发送方
+  void startRead();
+  void stopRead();
+  bool isReading() const { return reading_; }  // 只能在循环线程中调用
+
+  // 读方向的自动反压：输入缓冲区中未处理的数据加上应用报告的积压量
+  // 达到highWaterMark时暂停读取，降到lowWaterMark及以下时恢复，0表示不启用。
+  // highWaterMark应大于单条消息的最大长度，否则收不全的消息会一直卡住。
+  // 需要在循环线程中（例如连接回调里）设置
+  void setInputWatermarks(std::size_t highWaterMark, std::size_t lowWaterMark);
+  // 报告应用层尚未处理完的输入数据量（例如排在工作线程池中的请求），线程安全
+  void setInputBacklog(std::size_t bytes);
+
+  // 空闲超时：seconds秒内没有任何读写则关闭连接，0表示不启用
+  void setIdleTimeout(double seconds);
+  // 读超时：输入缓冲区出现未处理完的数据后，必须在seconds秒内被消费完，
+  // 否则关闭连接（防止slowloris），0表示不启用
+  void setReadTimeout(double seconds);
+
+  // 边缘触发模式：写事件常驻epoll，读写都进行到EAGAIN为止。
+  // 需要在connectEstablished之前设置
+  void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+  bool edgeTriggered() const { return edgeTriggered_; }
+
+  // 合并发送模式：同一轮循环中的多次send只追加到输出缓冲区，
+  // 本轮循环结束时用一次writev发出，减少系统调用和小的TCP报文段。
+  // 需要在循环线程中（例如连接回调里）设置
+  void setCorked(bool on) { corked_ = on; }
+  bool corked() const { return corked_; }
 
   // 连接建立
   void connectEstablished();
@@ -67,6 +158,32 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
   void connectDestroyed();
 
   private:
+  struct Outbound;  // 其他线程交给循环发送的数据
+  void queueOutbound(Outbound* message);
+  void drainOutbound();
+
+  // 不经过outputBuffer_发送的数据：零拷贝负载或文件的一段
+  struct OutputSegment {
+    OutputSegment()
+        : bufferedBefore(0),
+          offset(0),
+          pinned(false),
+          lastSeq(0),
+          fileFd(-1),
+          fileOffset(0),
+          fileRemaining(0) {}
+
+    std::size_t bufferedBefore;  // 之前还需发送的outputBuffer_字节数
+    ZeroCopyPayload payload;     // fileFd为-1时发送payload
+    std::size_t offset;          // payload已发送的字节数
+    bool pinned;                 // payload是否有部分以MSG_ZEROCOPY发出
+    uint32_t lastSeq;            // 最后一次MSG_ZEROCOPY发送的序号
+    int fileFd;                  // sendFile发送的文件，由连接负责关闭
+    off_t fileOffset;            // 下一次sendfile的文件位置
+    std::size_t fileRemaining;   // 文件还需发送的字节数
+  };
+  enum ZeroCopyState { kZeroCopyUnknown, kZeroCopyOn, kZeroCopyOff };
+
   enum StateE {
     kDisconnected,  // 已经断开连接
     kConnecting,    // 正在连接
@@ -76,18 +193,48 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
   void setState(StateE state) { state_ = state; }
 
   void handleRead(Timestamp receiveTime);
+  void startReadInLoop();
+  void stopReadInLoop();
+  void updateReadThrottle();
+  void updateReading();
   void handleWrite();
   void handleClose();
   void handleError();
 
   void sendInLoop(const char* data, std::size_t len);
-  void sendInLoop(const std::string& message);
+  void sendInLoop(const char* data, std::size_t len, const Slice* slice);
+  void sendSliceInLoop(const Slice& slice);
+  void appendOutput(const char* data, std::size_t len, const Slice* slice,
+                    std::size_t offset);
+  void sendZeroCopyInLoop(const ZeroCopyPayload& payload);
+  void sendFileInLoop(int fd, off_t offset, std::size_t length);
+  ssize_t writeOutput(int* savedErrno);
+  bool reapZeroCopy();
+  void scheduleFlush();
   void shutdownInLoop();
+  bool outputDrained() const;
+  bool outputEmpty() const;  // 输出缓冲区与segments_都没有待发送的数据
+  void appendSegment(OutputSegment segment);
+  void popSegment();
+  void flushInLoop();
+  bool admitOutput(std::size_t len);
+  void checkHighWaterMark(std::size_t oldlen);
+  void checkLowWaterMark();
+
+  void setIdleTimeoutInLoop(double seconds);
+  void setReadTimeoutInLoop(double seconds);
+  void touchIdleTimer();
+  void updateReadTimer();
+  void cancelTimers();
+  void handleIdleTimeout();
+  void handleReadTimeout();
+  void updateTrimTimer();
+  void handleTrimTimeout();
 
   EventLoop* loop_;
   const std::string name_;
   std::atomic_int state_;
-  // bool reading_;
+  bool reading_;  // 使用者是否允许读取（startRead/stopRead）
 
   std::unique_ptr<Socket> socket_;
   std::unique_ptr<Channel> channel_;
@@ -99,12 +246,39 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
   MessageCallback messageCallback_;              // 有读写消息时的回调
   WriteCompleteCallback writeCompleteCallback_;  // 消息发送完成以后的回调
   HighWaterMarkCallback highWaterMarkCallback_;
+  LowWaterMarkCallback lowWaterMarkCallback_;
   CloseCallback closeCallback_;
   std::size_t highWaterMark_;
+  std::size_t lowWaterMark_;
+  bool aboveHighWaterMark_;  // 越过高水位后尚未降到低水位
+  std::size_t outputLimit_;
+  int outputOverflowPolicy_;
+  std::size_t droppedSends_;
+  bool edgeTriggered_;
+  bool corked_;
+  std::size_t inputHighWaterMark_;
+  std::atomic<std::size_t> inputLowWaterMark_;  // 生产者线程也会读取
+  std::atomic<std::size_t> inputBacklog_;  // 应用报告的积压量
+  std::atomic<bool> readThrottled_;       // 是否因反压暂停了读取
+  bool flushPending_;  // 已登记在本轮循环末尾发送
 
-  // 数据缓冲区
+  double idleTimeout_;
+  double readTimeout_;
+  WheelTimer idleTimer_;
+  WheelTimer readTimer_;
+  WheelTimer trimTimer_;  // 输入缓冲区变大后空闲一段时间则收缩
+
+  // 数据缓冲区，待发送的数据可能很大，用分块缓冲区避免扩容时的整体拷贝
   Buffer inputBuffer_;
-  Buffer outputBuffer_;
+  ChainBuffer outputBuffer_;
+
+  MpscQueue<Outbound> outbound_;           // 其他线程交给循环的输出
+  std::atomic<bool> outboundScheduled_;  // 是否已向循环投递drainOutbound
+  bool drainingOutbound_;                // 是否正在执行drainOutbound
+  std::deque<OutputSegment> segments_;          // 尚未发完
+  std::deque<OutputSegment> zeroCopyInflight_;  // 已发完，内核仍在引用负载
+  int zeroCopyState_;
+  uint32_t zeroCopySeq_;  // 下一次MSG_ZEROCOPY发送的序号
 
   // For protobuf
   boost::any context_;
@@ -5,6 +5,7 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "tcpserver/acceptor.h"
 #include "util/buffer.h"
@@ -24,6 +25,9 @@ class TcpServer {
   enum Option {
     kNoReusePort,
     kReusePort,
+    // 每个subloop各自持有一个SO_REUSEPORT的Acceptor，
+    // 连接在哪个loop上accept就由哪个loop服务，不再经过mainloop
+    kReusePortPerLoop,
   };
 
   TcpServer(EventLoop *loop, const InetAddress &listenAddr,
@@ -43,25 +47,63 @@ class TcpServer {
     writeCompleteCallback_ = cb;
   }
 
-  // 设置底层subloop的个数
-  void setThreadNum(int numThreads);
+  // 新连接使用边缘触发模式，需要在start之前设置
+  void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+  // 设置底层subloop的个数，以及subloop线程的CPU亲和性策略
+  void setThreadNum(int numThreads,
+                    const CpuAffinity &affinity = CpuAffinity());
+
+  // 每次可读事件最多accept的连接数，需要在start之前设置
+  void setAcceptBatch(int batch);
+
+  // 所有Acceptor的统计之和，加上主机级别的listenOverflows/listenDrops，
+  // 线程安全
+  AcceptStats acceptStats() const;
+
+  // 新连接分配到subloop的策略，需要在start之前设置
+  void setLoadBalance(EventLoopThreadPool::LoadBalance loadBalance);
 
   // 开启服务器监听
   void start();
 
+  // 监听的地址，构造时端口为0的话start之后是内核分配的端口
+  const InetAddress &listenAddress() const { return listenAddr_; }
+
  private:
+  using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+
+  // kReusePortPerLoop模式下一个subloop的监听器与连接，只在该loop线程中访问
+  struct LoopAcceptor {
+    EventLoop *loop;
+    std::unique_ptr<Acceptor> acceptor;
+    ConnectionMap connections;
+  };
+
   void newConnection(int sockfd, const InetAddress &peerAddr);
   void removeConnection(const TcpConnectionPtr &conn);
   void removeConnectionInLoop(const TcpConnectionPtr &conn);
 
-  using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+  void startLoopAcceptors();
+  void stopLoopAcceptors();
+  void newLoopConnection(LoopAcceptor *acceptor, int sockfd,
+                         const InetAddress &peerAddr);
+  void removeLoopConnection(LoopAcceptor *acceptor,
+                            const TcpConnectionPtr &conn);
+
+  TcpConnectionPtr createConnection(EventLoop *ioLoop, int sockfd,
+                                    const InetAddress &peerAddr);
 
   EventLoop *loop_;  // baseloop 用户自定义的loop
 
-  const std::string ipPort_;
+  std::string ipPort_;  // 连接名中的监听地址，端口为0时更新为实际端口
   const std::string name_;
+  InetAddress listenAddr_;
+  const bool acceptorPerLoop_;
+  int acceptBatch_;  // 0表示使用Acceptor的默认值
 
-  std::unique_ptr<Acceptor> acceptor_;  // 运行在mainloop 任务就是监听新连接事件
+  // 运行在mainloop 任务就是监听新连接事件，kReusePortPerLoop模式下为空
+  std::unique_ptr<Acceptor> acceptor_;
 
   std::shared_ptr<EventLoopThreadPool> threadPool_;  // one loop per thread
 
@@ -72,8 +114,11 @@ class TcpServer {
   ThreadInitCallback threadInitCallback_;  // loop线程初始化的回调
 
   std::atomic_int started_;
+  bool edgeTriggered_;
 
-  int nextConnId_;
+  std::atomic_int nextConnId_;
   ConnectionMap connections_;  // 保存所有的连接
+
+  std::vector<std::unique_ptr<LoopAcceptor>> loopAcceptors_;
 };
 }  // namespace Tnet
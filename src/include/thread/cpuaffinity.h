@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+namespace Tnet {
+
+// 一个loop线程的位置：绑定的CPU集合以及内存优先分配的NUMA节点
+struct CpuPlacement {
+  CpuPlacement() : numaNode(-1) {}
+
+  std::vector<int> cpus;  // 为空表示不绑定CPU
+  int numaNode;           // -1表示不设置内存策略
+};
+
+// EventLoopThreadPool中loop线程的CPU亲和性策略。
+// CPU拓扑从/sys读取，并且只使用进程当前允许运行的CPU（taskset、cgroup）。
+class CpuAffinity {
+ public:
+  enum Policy {
+    kNone,          // 不绑定，由调度器决定
+    kCpuList,       // 第i个loop绑定到列表中的第i个CPU，不够时循环使用
+    kPhysicalCore,  // 每个loop独占一个物理核，不与超线程兄弟共享
+    kNumaNode,      // loop轮流分布到各个NUMA节点，绑定节点的CPU与内存
+  };
+
+  CpuAffinity() : policy_(kNone) {}
+
+  static CpuAffinity cpuList(const std::vector<int>& cpus);
+  static CpuAffinity physicalCores();
+  static CpuAffinity numaNodes();
+
+  Policy policy() const { return policy_; }
+
+  // 为numThreads个loop线程计算各自的位置
+  std::vector<CpuPlacement> plan(int numThreads) const;
+
+  // 让当前线程按placement运行，失败时记录日志并返回false
+  static bool apply(const CpuPlacement& placement);
+
+ private:
+  explicit CpuAffinity(Policy policy) : policy_(policy) {}
+
+  Policy policy_;
+  std::vector<int> cpus_;
+};
+
+}  // namespace Tnet
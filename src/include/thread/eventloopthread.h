@@ -6,6 +6,7 @@
 #include <string>
 
 #include "util/macros.h"
+#include "thread/cpuaffinity.h"
 #include "thread/thread.h"
 
 namespace Tnet {
@@ -22,6 +23,9 @@ class EventLoopThread {
 
   DISALLOW_COPY(EventLoopThread)
 
+  // 线程启动后、创建EventLoop之前生效，需要在startLoop之前设置
+  void setPlacement(const CpuPlacement &placement) { placement_ = placement; }
+
   EventLoop *startLoop();
 
  private:
@@ -33,6 +37,7 @@ class EventLoopThread {
   std::mutex mutex_;              // 互斥锁
   std::condition_variable cond_;  // 条件变量
   ThreadInitCallback callback_;
+  CpuPlacement placement_;
 };
 
 }  // namespace Tnet
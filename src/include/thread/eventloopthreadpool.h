@@ -3,8 +3,10 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "thread/cpuaffinity.h"
 #include "util/macros.h"
 
 namespace Tnet {
@@ -16,17 +18,30 @@ class EventLoopThreadPool {
  public:
   using ThreadInitCallback = std::function<void(EventLoop *)>;
 
+  // 新连接分配到subLoop的策略
+  enum LoadBalance {
+    kRoundRobin,        // 轮询
+    kLeastConnections,  // 当前连接数最少的loop
+    kLeastUtilization,  // 最近利用率最低的loop
+    kConsistentHash,    // 按hashCode（如对端地址）一致性哈希，同一来源落在同一loop
+  };
+
   EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg);
   ~EventLoopThreadPool();
 
   DISALLOW_COPY(EventLoopThreadPool)
 
   void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+  // loop线程的CPU亲和性策略，需要在start之前设置
+  void setAffinity(const CpuAffinity &affinity) { affinity_ = affinity; }
+  // 需要在start之前设置
+  void setLoadBalance(LoadBalance loadBalance) { loadBalance_ = loadBalance; }
 
   void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
-  // baseLoop_(mainLoop)会默认以轮询的方式分配Channel给subLoop
-  EventLoop *getNextLoop();
+  // 按LoadBalance策略为新连接选择一个subLoop，没有subLoop时返回baseLoop_。
+  // hashCode只在kConsistentHash下使用
+  EventLoop *getNextLoop(size_t hashCode = 0);
 
   std::vector<EventLoop *> getAllLoops();
 
@@ -34,11 +49,20 @@ class EventLoopThreadPool {
   const std::string name() const { return name_; }
 
  private:
+  EventLoop *roundRobinLoop();
+  EventLoop *leastConnectionsLoop();
+  EventLoop *leastUtilizationLoop();
+  EventLoop *consistentHashLoop(size_t hashCode);
+  void buildHashRing();
+
   EventLoop *baseLoop_;
   std::string name_;
   bool started_;
   int numThreads_;
   int next_;  // 轮询的下标
+  CpuAffinity affinity_;
+  LoadBalance loadBalance_;
+  std::vector<std::pair<uint32_t, EventLoop *>> hashRing_;  // 按哈希值排序的虚拟节点
   std::vector<std::unique_ptr<EventLoopThread>> threads_;
   std::vector<EventLoop *> loops_;
 };
@@ -6,7 +6,6 @@
 
 #include <algorithm>
 #include <string>
-#include <vector>
 #include "tcpserver/endian.h"
 #include "util/log.h"
 #include "util/macros.h"
@@ -17,21 +16,39 @@ class Buffer {
   static const std::size_t kCheapPrepend = 8;    // 预留的前置空间
   static const std::size_t kInitialSize = 1024;  // 初始大小
 
+  // 存储空间在第一次写入时才从BufferPool申请，缓冲区被读空时归还
   explicit Buffer(std::size_t initialSize = kInitialSize)
-      : buffer_(kCheapPrepend + initialSize),
+      : data_(nullptr),
+        capacity_(0),
         readerIndex_(kCheapPrepend),
-        writerIndex_(kCheapPrepend) {
+        writerIndex_(kCheapPrepend),
+        initialSize_(initialSize),
+        sizeHint_(kCheapPrepend + initialSize),
+        borrowed_(false) {
     assert(readableBytes() == 0);
-    assert(writableBytes() == initialSize);
     assert(prependableBytes() == kCheapPrepend);
   }
+  ~Buffer() { release(); }
+
+  // 移动只交换存储空间，可以把缓冲区整个交给另一个线程
+  Buffer(Buffer&& other) : Buffer(other.initialSize_) { swap(other); }
+  Buffer& operator=(Buffer&& other) {
+    if (this != &other) {
+      retrieveAll();
+      swap(other);
+    }
+    return *this;
+  }
+  void swap(Buffer& rhs);
 
   DISALLOW_COPY(Buffer);
 
   // 可读数据的大小
   std::size_t readableBytes() const { return writerIndex_ - readerIndex_; }
   // 可写数据的大小
-  std::size_t writableBytes() const { return buffer_.size() - writerIndex_; }
+  std::size_t writableBytes() const {
+    return capacity_ > writerIndex_ ? capacity_ - writerIndex_ : 0;
+  }
   // 前置空间的大小
   std::size_t prependableBytes() const { return readerIndex_; }
 
@@ -47,8 +64,11 @@ class Buffer {
     }
   }
 
-  // 重置缓冲区
-  void retrieveAll() { readerIndex_ = writerIndex_ = kCheapPrepend; }
+  // 重置缓冲区，存储空间归还给BufferPool
+  void retrieveAll() {
+    release();
+    readerIndex_ = writerIndex_ = kCheapPrepend;
+  }
 
   std::string retrieveAllAsString() {
     return retrieveAsString(readableBytes());
@@ -95,6 +115,12 @@ class Buffer {
 
   // 读取数据
   ssize_t readFd(int fd, int* saveErrno);
+  // 借助外部的scratch空间读取数据：缓冲区为空时直接读入scratch并把它借作
+  // 存储空间，不占用自己的内存；否则scratch代替栈上空间暂存溢出的数据。
+  // 借用期间可以正常读写缓冲区，用完scratch之前必须调用returnScratch
+  ssize_t readFd(int fd, int* saveErrno, char* scratch, std::size_t size);
+  // 归还借用的scratch，未读完的数据拷贝到自己的存储空间
+  void returnScratch();
   // 发送数据
   ssize_t writeFd(int fd, int* saveErrno);
 
@@ -110,31 +136,39 @@ class Buffer {
 
   void prepend(const void* data, std::size_t len) {
     assert(len <= prependableBytes());
+    if (data_ == nullptr) {
+      allocate(sizeHint_);
+    }
     readerIndex_ -= len;
     const char* d = static_cast<const char*>(data);
     std::copy(d, d + len, begin() + readerIndex_);
   }
 
+  // 实际占用的存储空间，没有数据时为0
+  std::size_t internalCapacity() const { return capacity_; }
+
+  // 把存储空间缩小到刚好容纳可读数据，没有可读数据时直接归还
+  void shrink();
+
   private:
-  char* begin() { return &*buffer_.begin(); }
-  const char* begin() const { return &*buffer_.begin(); }
+  static char emptyStorage_[kCheapPrepend];  // 没有存储空间时begin()的位置
 
-  // 扩容逻辑
-  void makeSpace(std::size_t len) {
-    if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
-      buffer_.resize(writerIndex_ + len);
-    } else {
-      std::size_t readable = readableBytes();
-      std::copy(begin() + readerIndex_, begin() + writerIndex_,
-                begin() + kCheapPrepend);
-      readerIndex_ = kCheapPrepend;
-      writerIndex_ = readerIndex_ + readable;
-    }
+  char* begin() { return data_ != nullptr ? data_ : emptyStorage_; }
+  const char* begin() const {
+    return data_ != nullptr ? data_ : emptyStorage_;
   }
 
-  std::vector<char> buffer_;  // 实际存储数据的vector
-  std::size_t readerIndex_;   // 读索引
-  std::size_t writerIndex_;   // 写索引
+  void makeSpace(std::size_t len);
+  void allocate(std::size_t size);
+  void release();
+
+  char* data_;               // 从BufferPool申请的存储空间，可能为nullptr
+  std::size_t capacity_;     // 存储空间的大小
+  std::size_t readerIndex_;  // 读索引
+  std::size_t writerIndex_;  // 写索引
+  std::size_t initialSize_;
+  std::size_t sizeHint_;  // 下次申请存储空间的大小，取上次读空前用到的大小
+  bool borrowed_;         // data_是否为借用的scratch空间
 };
 
 }  // namespace Tnet
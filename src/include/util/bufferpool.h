@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+
+#include "util/macros.h"
+
+namespace Tnet {
+
+// 按大小分级缓存内存块的线程本地池，供Buffer与ChainBuffer使用。
+// 块大小为kMinBlockSize到kMaxBlockSize之间的2的幂，每一级用一个空闲链表
+// 保存释放的块，超过kMaxCachedBytes的部分直接还给系统，但每一级至少能缓存
+// kMinCachedBlocks个块，大块也能被复用；更大的请求不经过缓存。
+// 每个loop线程有自己的池，热点连接反复申请释放缓冲区时只是链表操作。
+// 块可以在任意线程释放，释放时放入当前线程的池中。
+class BufferPool {
+ public:
+  static const std::size_t kMinBlockSize = 1024;
+  static const std::size_t kMaxBlockSize = 1024 * 1024;
+  static const int kNumClasses = 11;  // 1KB ~ 1MB
+  static const std::size_t kMaxCachedBytes = 512 * 1024;  // 每一级的上限
+  static const std::size_t kMinCachedBlocks = 2;  // 每一级至少缓存的块数
+
+  // 分配至少size字节的块，实际大小写入*capacity。
+  // 内存不足时抛出std::bad_alloc
+  static char* allocate(std::size_t size, std::size_t* capacity);
+  // 释放allocate得到的块，capacity必须是分配时返回的大小
+  static void deallocate(char* data, std::size_t capacity);
+
+  // 当前线程的池中缓存的字节数
+  static std::size_t cachedBytes();
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  struct SizeClass {
+    FreeBlock* head;
+    std::size_t count;
+  };
+
+  BufferPool();
+  ~BufferPool();
+
+  DISALLOW_COPY(BufferPool)
+
+  // 当前线程的池，线程退出、池已析构后返回nullptr
+  static BufferPool* threadLocal();
+  static int classOf(std::size_t size);
+
+  SizeClass classes_[kNumClasses];
+  std::size_t cachedBytes_;
+};
+
+}  // namespace Tnet
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "util/macros.h"
+#include "util/slice.h"
+
+namespace Tnet {
+
+// 由固定大小的块串成的缓冲区。
+// 追加数据时只在末尾补充新块，已有数据不会因扩容而被realloc或搬移，
+// 块从BufferPool申请，发送完即归还；
+// readFd/writeFd通过readv/writev直接在各块上收发。
+// 需要连续视图时用pullup/peek把开头的数据合并到一个块中。
+// 较大的Slice按引用串入，不拷贝数据。
+class ChainBuffer {
+ public:
+  static const std::size_t kBlockSize = 16 * 1024;
+
+  ChainBuffer();
+  ~ChainBuffer();
+
+  DISALLOW_COPY(ChainBuffer)
+
+  std::size_t readableBytes() const { return readable_; }
+
+  // 保证前len个可读字节连续存放并返回起始指针，跨块时合并到一个新块中
+  const char* pullup(std::size_t len);
+  // 全部可读数据的连续视图
+  const char* peek() { return pullup(readable_); }
+
+  void retrieve(std::size_t len);
+  void retrieveAll();
+  std::string retrieveAllAsString() { return retrieveAsString(readable_); }
+  std::string retrieveAsString(std::size_t len);
+
+  void append(const char* data, std::size_t len);
+  void append(const void* data, std::size_t len) {
+    append(static_cast<const char*>(data), len);
+  }
+
+  // 按引用追加slice，只增加引用计数；小于kMinSliceReference时直接拷贝更划算
+  void append(const Slice& slice);
+  static const std::size_t kMinSliceReference = 1024;
+
+  void appendInt32(int32_t x);
+  int32_t peekInt32();
+
+  // 读取数据
+  ssize_t readFd(int fd, int* saveErrno);
+  // 发送数据，一次writev覆盖多个块，最多发送maxBytes字节
+  ssize_t writeFd(int fd, int* saveErrno,
+                  std::size_t maxBytes = static_cast<std::size_t>(-1));
+
+ private:
+  struct Block {
+    char* data;
+    std::size_t capacity;
+    std::size_t begin;  // 可读数据的起始位置
+    std::size_t end;    // 可读数据的结束位置，之后为可写空间
+    // 非空表示块引用的是Slice的数据：只读、没有可写空间、不归还BufferPool
+    std::shared_ptr<const std::string> owner;
+
+    std::size_t readable() const { return end - begin; }
+    std::size_t writable() const { return capacity - end; }
+  };
+
+  Block newBlock(std::size_t capacity);
+  void freeBlock(Block* block);
+  void popFront();
+
+  std::deque<Block> blocks_;
+  std::size_t readable_;
+};
+
+}  // namespace Tnet
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Tnet {
+
+template <typename Signature, size_t Capacity>
+class InplaceFunction;
+
+// 只能移动的函数对象，可调用对象不超过Capacity字节时直接存放在内部缓冲区中，
+// 构造、移动、调用都不分配内存；超出时退化为在堆上保存，保证任意可调用对象都能使用。
+template <typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity> {
+ public:
+  InplaceFunction() : ops_(nullptr) {}
+  InplaceFunction(std::nullptr_t) : ops_(nullptr) {}
+
+  template <typename F,
+            typename = typename std::enable_if<!std::is_same<
+                typename std::decay<F>::type, InplaceFunction>::value>::type>
+  InplaceFunction(F&& f) : ops_(nullptr) {
+    using Callable = typename std::decay<F>::type;
+    using Storage = typename std::conditional<fitsInline<Callable>(),
+                                              InlineStorage<Callable>,
+                                              HeapStorage<Callable>>::type;
+    Storage::create(&storage_, std::forward<F>(f));
+    ops_ = &Storage::kOps;
+  }
+
+  InplaceFunction(InplaceFunction&& other) : ops_(other.ops_) {
+    if (ops_ != nullptr) {
+      ops_->move(&storage_, &other.storage_);
+      other.ops_ = nullptr;
+    }
+  }
+
+  InplaceFunction& operator=(InplaceFunction&& other) {
+    if (this != &other) {
+      reset();
+      if (other.ops_ != nullptr) {
+        other.ops_->move(&storage_, &other.storage_);
+        ops_ = other.ops_;
+        other.ops_ = nullptr;
+      }
+    }
+    return *this;
+  }
+
+  InplaceFunction& operator=(std::nullptr_t) {
+    reset();
+    return *this;
+  }
+
+  InplaceFunction(const InplaceFunction&) = delete;
+  InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+  ~InplaceFunction() { reset(); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  R operator()(Args... args) {
+    return ops_->invoke(&storage_, std::forward<Args>(args)...);
+  }
+
+  // 可调用对象F能否存放在内部缓冲区中
+  template <typename F>
+  static constexpr bool fitsInline() {
+    return sizeof(F) <= Capacity && alignof(F) <= alignof(Buffer) &&
+           std::is_nothrow_move_constructible<F>::value;
+  }
+
+ private:
+  using Buffer = typename std::aligned_storage<Capacity>::type;
+
+  struct Ops {
+    R (*invoke)(void* storage, Args&&... args);
+    void (*move)(void* dst, void* src);  // 移动后src中的对象已被销毁
+    void (*destroy)(void* storage);
+  };
+
+  template <typename F>
+  struct InlineStorage {
+    template <typename T>
+    static void create(void* storage, T&& f) {
+      new (storage) F(std::forward<T>(f));
+    }
+    static R invoke(void* storage, Args&&... args) {
+      return (*static_cast<F*>(storage))(std::forward<Args>(args)...);
+    }
+    static void move(void* dst, void* src) {
+      F* from = static_cast<F*>(src);
+      new (dst) F(std::move(*from));
+      from->~F();
+    }
+    static void destroy(void* storage) { static_cast<F*>(storage)->~F(); }
+
+    static const Ops kOps;
+  };
+
+  template <typename F>
+  struct HeapStorage {
+    template <typename T>
+    static void create(void* storage, T&& f) {
+      *static_cast<F**>(storage) = new F(std::forward<T>(f));
+    }
+    static R invoke(void* storage, Args&&... args) {
+      return (**static_cast<F**>(storage))(std::forward<Args>(args)...);
+    }
+    static void move(void* dst, void* src) {
+      *static_cast<F**>(dst) = *static_cast<F**>(src);
+    }
+    static void destroy(void* storage) { delete *static_cast<F**>(storage); }
+
+    static const Ops kOps;
+  };
+
+  void reset() {
+    if (ops_ != nullptr) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  Buffer storage_;
+  const Ops* ops_;
+};
+
+template <typename R, typename... Args, size_t Capacity>
+template <typename F>
+const typename InplaceFunction<R(Args...), Capacity>::Ops
+    InplaceFunction<R(Args...), Capacity>::InlineStorage<F>::kOps = {
+        &InlineStorage<F>::invoke, &InlineStorage<F>::move,
+        &InlineStorage<F>::destroy};
+
+template <typename R, typename... Args, size_t Capacity>
+template <typename F>
+const typename InplaceFunction<R(Args...), Capacity>::Ops
+    InplaceFunction<R(Args...), Capacity>::HeapStorage<F>::kOps = {
+        &HeapStorage<F>::invoke, &HeapStorage<F>::move,
+        &HeapStorage<F>::destroy};
+
+}  // namespace Tnet
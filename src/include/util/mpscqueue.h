@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+
+#include "util/macros.h"
+
+namespace Tnet {
+
+// 侵入式节点，放入MpscQueue的类型需要继承它
+struct MpscNode {
+  MpscNode() : next(nullptr) {}
+
+  std::atomic<MpscNode*> next;
+};
+
+// 侵入式无锁多生产者单消费者队列（Vyukov算法）。
+// push可以在任意线程调用，只需一次原子交换；pop只能由唯一的消费者调用。
+// 队列不拥有节点，节点的释放由使用者负责。
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+  DISALLOW_COPY(MpscQueue)
+
+  void push(T* node) { pushNode(node); }
+
+  // 队列为空，或某个生产者正处于push中间状态时返回nullptr
+  T* pop() {
+    MpscNode* tail = tail_;
+    MpscNode* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+      if (next == nullptr) {
+        return nullptr;
+      }
+      tail_ = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr) {
+      tail_ = next;
+      return static_cast<T*>(tail);
+    }
+
+    MpscNode* head = head_.load(std::memory_order_acquire);
+    if (tail != head) {
+      return nullptr;
+    }
+    // tail是最后一个节点，放回哨兵后才能把它取出
+    pushNode(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+      tail_ = next;
+      return static_cast<T*>(tail);
+    }
+    return nullptr;
+  }
+
+ private:
+  void pushNode(MpscNode* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    MpscNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  static const int kCacheLineSize = 64;
+
+  // 生产者与消费者访问的字段放在不同的cache line上
+  std::atomic<MpscNode*> head_;
+  char pad_[kCacheLineSize - sizeof(std::atomic<MpscNode*>)]
+      __attribute__((unused));
+  MpscNode* tail_;
+  MpscNode stub_;
+};
+
+}  // namespace Tnet
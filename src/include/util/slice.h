@@ -0,0 +1,61 @@
+#pragma once
+
+#include <assert.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "util/buffer.h"
+
+namespace Tnet {
+
+class ChainBuffer;
+
+// 不可变、引用计数的一段数据。复制Slice只增加引用计数，不拷贝数据，
+// 同一条消息序列化一次后可以发给任意多个连接（TcpConnection::send(Slice)），
+// ChainBuffer按引用把它串进输出缓冲区，直到发送完才释放引用。
+class Slice {
+ public:
+  Slice() : data_(nullptr), size_(0) {}
+
+  // 接管data的内容，不拷贝
+  explicit Slice(std::string&& data)
+      : storage_(std::make_shared<const std::string>(std::move(data))),
+        data_(storage_->data()),
+        size_(storage_->size()) {}
+
+  Slice(const char* data, std::size_t len)
+      : storage_(std::make_shared<const std::string>(data, len)),
+        data_(storage_->data()),
+        size_(len) {}
+
+  // 取出buf中全部可读数据
+  explicit Slice(Buffer* buf) : Slice(buf->retrieveAllAsString()) {}
+
+  const char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // 共享同一份数据的子区间
+  Slice subslice(std::size_t offset, std::size_t len) const {
+    assert(offset + len <= size_);
+    Slice slice(*this);
+    slice.data_ += offset;
+    slice.size_ = len;
+    return slice;
+  }
+  Slice subslice(std::size_t offset) const {
+    return subslice(offset, size_ - offset);
+  }
+
+ private:
+  friend class ChainBuffer;
+
+  std::shared_ptr<const std::string> storage_;
+  const char* data_;
+  std::size_t size_;
+};
+
+}  // namespace Tnet
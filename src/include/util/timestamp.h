@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 #include <iostream>
 #include <string>
 
@@ -10,9 +12,36 @@ class Timestamp {
   Timestamp();
   explicit Timestamp(int64_t microSecondsSinceEpoch);
   static Timestamp now();
+  static Timestamp invalid() { return Timestamp(0); }
   std::string toString() const;
 
+  bool valid() const { return microSecondsSinceEpoch_ > 0; }
+  int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+
+  static const int kMicroSecondsPerSecond = 1000 * 1000;
+
  private:
   int64_t microSecondsSinceEpoch_;
 };
+
+inline bool operator<(Timestamp lhs, Timestamp rhs) {
+  return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs) {
+  return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// 两个时间点的差值，单位为秒
+inline double timeDifference(Timestamp high, Timestamp low) {
+  int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+  return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+// 在timestamp的基础上增加seconds秒
+inline Timestamp addTime(Timestamp timestamp, double seconds) {
+  int64_t delta =
+      static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+  return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
 }  // namespace Tnet
@@ -1,10 +1,19 @@
 #include "tcpserver/acceptor.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <fstream>
+#include <sstream>
+#include <string>
+
 #include "tcpserver/inetaddress.h"
 #include "util/log.h"
 
@@ -24,17 +33,26 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr,
     : loop_(loop),
       acceptSocket_(createNonblocking()),
       acceptChannel_(loop, acceptSocket_.fd()),
-      listenning_(false) {
+      listenning_(false),
+      acceptBatch_(kDefaultAcceptBatch),
+      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+      acceptedCount_(0),
+      rejectedCount_(0),
+      batchFullCount_(0) {
   acceptSocket_.setReuseAddr(true);
   acceptSocket_.setReusePort(reuseport);
   acceptSocket_.bindAddress(listenAddr);
 
+  acceptChannel_.setName("Acceptor");
   acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
 }
 
 Acceptor::~Acceptor() {
   acceptChannel_.disableAll();
   acceptChannel_.remove();
+  if (idleFd_ >= 0) {
+    ::close(idleFd_);
+  }
 }
 
 void Acceptor::listen() {
@@ -44,23 +62,111 @@ void Acceptor::listen() {
   acceptChannel_.enableReading();
 }
 
+// 一次可读事件中连续accept，直到队列取空或达到批量上限，
+// 连接风暴时不必每个连接都经过一轮epoll_wait
 void Acceptor::handleRead() {
   loop_->assertInLoopThread();
-  InetAddress peerAddr;
-  int connfd = acceptSocket_.accept(&peerAddr);
+  for (int i = 0; i < acceptBatch_; ++i) {
+    InetAddress peerAddr;
+    int connfd = acceptSocket_.accept(&peerAddr);
+    if (connfd >= 0) {
+      acceptedCount_.fetch_add(1, std::memory_order_relaxed);
+      if (NewConnectionCallback_) {
+        NewConnectionCallback_(connfd, peerAddr);
+      } else {
+        ::close(connfd);
+      }
+      continue;
+    }
+
+    int savedErrno = errno;
+    switch (savedErrno) {
+      case EAGAIN:
+        return;  // 队列已取空
+      case EINTR:
+      case ECONNABORTED:
+      case EPROTO:
+        continue;  // 只影响这一个连接
+      case EMFILE:
+      case ENFILE:
+        if (!rejectOne()) {
+          return;
+        }
+        continue;
+      default:
+        LOG_ERROR("%s:%s:%d accept err:%d\n", __FILE__, __FUNCTION__,
+                  __LINE__, savedErrno);
+        return;
+    }
+  }
+  batchFullCount_.fetch_add(1, std::memory_order_relaxed);
+}
+
+// fd耗尽时水平触发的监听fd会一直可读，把循环空转到100% CPU。
+// 先释放预留的fd，accept后立即关闭，让对端尽快得到断开而不是一直等待
+bool Acceptor::rejectOne() {
+  LOG_ERROR("%s:%s:%d sockfd reached limit\n", __FILE__, __FUNCTION__,
+            __LINE__);
+  if (idleFd_ >= 0) {
+    ::close(idleFd_);
+    idleFd_ = -1;
+  }
+  int connfd = ::accept4(acceptSocket_.fd(), nullptr, nullptr, SOCK_CLOEXEC);
   if (connfd >= 0) {
-    if (NewConnectionCallback_) {
-      NewConnectionCallback_(connfd, peerAddr);
-    } else {
-      ::close(connfd);
+    ::close(connfd);
+    rejectedCount_.fetch_add(1, std::memory_order_relaxed);
+  }
+  idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+  return connfd >= 0;
+}
+
+InetAddress Acceptor::listenAddress() const {
+  sockaddr_in local;
+  ::memset(&local, 0, sizeof(local));
+  socklen_t addrlen = sizeof(local);
+  if (::getsockname(acceptSocket_.fd(), (sockaddr*)&local, &addrlen) < 0) {
+    LOG_ERROR("Acceptor::listenAddress getsockname error:%d\n", errno);
+  }
+  return InetAddress(local);
+}
+
+AcceptStats Acceptor::stats() const {
+  AcceptStats stats;
+  stats.accepted = acceptedCount_.load(std::memory_order_relaxed);
+  stats.rejected = rejectedCount_.load(std::memory_order_relaxed);
+  stats.batchFull = batchFullCount_.load(std::memory_order_relaxed);
+  // 对监听socket，tcpi_unacked是全连接队列的当前长度
+  struct tcp_info info;
+  socklen_t len = sizeof(info);
+  ::memset(&info, 0, sizeof(info));
+  if (::getsockopt(acceptSocket_.fd(), IPPROTO_TCP, TCP_INFO, &info, &len) ==
+      0) {
+    stats.acceptQueue = static_cast<int>(info.tcpi_unacked);
+  }
+  return stats;
+}
+
+// /proc/net/netstat中TcpExt是一行字段名加一行数值
+void Acceptor::readListenOverflows(AcceptStats* stats) {
+  std::ifstream netstat("/proc/net/netstat");
+  std::string names;
+  std::string values;
+  while (std::getline(netstat, names) && std::getline(netstat, values)) {
+    if (names.compare(0, 7, "TcpExt:") != 0) {
+      continue;
     }
-  } else {
-    LOG_ERROR("%s:%s:%d accept err:%d\n", __FILE__, __FUNCTION__, __LINE__,
-              errno);
-    if (errno == EMFILE) {
-      LOG_ERROR("%s:%s:%d sockfd reached limit\n", __FILE__, __FUNCTION__,
-                __LINE__);
+    std::istringstream nameStream(names);
+    std::istringstream valueStream(values);
+    std::string name;
+    std::string value;
+    while (nameStream >> name && valueStream >> value) {
+      if (name == "ListenOverflows") {
+        stats->listenOverflows = ::strtoull(value.c_str(), nullptr, 10);
+      } else if (name == "ListenDrops") {
+        stats->listenDrops = ::strtoull(value.c_str(), nullptr, 10);
+      }
     }
+    return;
   }
 }
 
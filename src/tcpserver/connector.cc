@@ -8,6 +8,8 @@
 
 #include <errno.h>
 
+#include <algorithm>
+
 namespace Tnet {
 
 const int Connector::kMaxRetryDelayMs;
@@ -121,8 +123,10 @@ void Connector::stop() {
   loop_->queueInLoop(std::bind(&Connector::stopInLoop, this));
 }
 
+// retryTimer_只在循环线程中读写
 void Connector::stopInLoop() {
   loop_->assertInLoopThread();
+  loop_->cancel(retryTimer_);
   if (state_ == kConnecting) {
     setState(kDisconnected);
     int sockfd = removeAndResetChannel();
@@ -148,8 +152,11 @@ void Connector::retry(int sockfd) {
   if (connect_) {
     LOG_INFO("Connector::retry - Retry connecting to %s in %d milliseconds.",
              serverAddr_.toIpPort().c_str(), retryDelayMs_);
-    sleep(retryDelayMs_);
-    loop_->runInLoop(std::bind(&Connector::startInLoop, this));
+    setState(kDisconnected);
+    retryTimer_ = loop_->runAfter(
+        retryDelayMs_ / 1000.0,
+        std::bind(&Connector::startInLoop, shared_from_this()));
+    retryDelayMs_ = std::min(retryDelayMs_ * 2, kMaxRetryDelayMs);
   } else {
     LOG_DEBUG("do not connect");
   }
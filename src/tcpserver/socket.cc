@@ -1,5 +1,6 @@
 #include "tcpserver/socket.h"
 
+#include <errno.h>
 #include <fcntl.h>
 #include <netinet/tcp.h>
 #include <stdio.h>
@@ -65,6 +66,47 @@ void Socket::setKeepAlive(bool on) {
   ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
 }
 
+void Socket::setBusyPoll(int usec) {
+  // 超过net.core.busy_read需要CAP_NET_ADMIN
+  if (::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) <
+      0) {
+    LOG_WARN("setsockopt SO_BUSY_POLL sockfd:%d error:%d\n", sockfd_, errno);
+  }
+#ifdef SO_PREFER_BUSY_POLL
+  int optval = usec > 0 ? 1 : 0;
+  ::setsockopt(sockfd_, SOL_SOCKET, SO_PREFER_BUSY_POLL, &optval,
+               sizeof(optval));
+#endif
+}
+
+bool Socket::setZeroCopy(bool on) {
+#ifdef SO_ZEROCOPY
+  int optval = on ? 1 : 0;
+  if (::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval,
+                   sizeof(optval)) == 0) {
+    return true;
+  }
+  LOG_WARN("setsockopt SO_ZEROCOPY sockfd:%d error:%d\n", sockfd_, errno);
+#else
+  (void)on;
+#endif
+  return false;
+}
+
+void Socket::setNotSentLowat(unsigned int bytes) {
+#ifdef TCP_NOTSENT_LOWAT
+  // 0表示不单独设置，使用sysctl net.ipv4.tcp_notsent_lowat的值
+  unsigned int optval = bytes;
+  if (::setsockopt(sockfd_, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &optval,
+                   sizeof(optval)) < 0) {
+    LOG_WARN("setsockopt TCP_NOTSENT_LOWAT sockfd:%d error:%d\n", sockfd_,
+             errno);
+  }
+#else
+  (void)bytes;
+#endif
+}
+
 int Socket::getSocketError(int sockfd) {
   int optval;
   socklen_t optlen = static_cast<socklen_t>(sizeof(optval));
@@ -1,11 +1,18 @@
 #include "tcpserver/tcpconnection.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <string.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <functional>
 #include <string>
 
@@ -16,6 +23,50 @@
 
 namespace Tnet {
 
+// 输入缓冲区超过kTrimThreshold且kTrimDelay秒内没有新数据时收缩。
+// 读空的缓冲区会立即把存储空间还给BufferPool，这里只处理留有半个消息的情况
+static const std::size_t kTrimThreshold = 64 * 1024;
+static const double kTrimDelay = 5.0;
+
+const std::size_t TcpConnection::kZeroCopyThreshold;
+
+// 单次sendfile的上限，与内核对一次读写的限制一致
+static const std::size_t kMaxSendFileChunk = 0x7ffff000;
+
+// 其他线程的各种输出统一经过outbound_，同一线程的发送保持调用顺序
+struct TcpConnection::Outbound : public MpscNode {
+  enum Kind { kSlice, kBuffer, kZeroCopy, kFile };
+
+  explicit Outbound(Kind k)
+      : kind(k), fileFd(-1), fileOffset(0), fileLength(0) {}
+  explicit Outbound(std::string&& s) : Outbound(kSlice) {
+    slice = Slice(std::move(s));
+  }
+  explicit Outbound(const Slice& s) : Outbound(kSlice) { slice = s; }
+  explicit Outbound(Buffer&& b) : Outbound(kBuffer) { buffer = std::move(b); }
+  explicit Outbound(ZeroCopyPayload p) : Outbound(kZeroCopy) {
+    payload = std::move(p);
+  }
+  Outbound(int fd, off_t offset, std::size_t length) : Outbound(kFile) {
+    fileFd = fd;
+    fileOffset = offset;
+    fileLength = length;
+  }
+  ~Outbound() {
+    if (fileFd >= 0) {
+      ::close(fileFd);
+    }
+  }
+
+  Kind kind;
+  Slice slice;
+  Buffer buffer;  // 没有数据时不占用存储空间
+  ZeroCopyPayload payload;
+  int fileFd;  // 由Outbound负责关闭，交给sendFileInLoop后置为-1
+  off_t fileOffset;
+  std::size_t fileLength;
+};
+
 void defaultConnectionCallback(const TcpConnectionPtr& conn) {
   LOG_INFO("Connection : %s -> %s is %s",
            conn->localAddress().toIpPort().c_str(),
@@ -40,12 +91,35 @@ TcpConnection::TcpConnection(EventLoop* loop, const std::string& nameArg,
     : loop_(CheckLoopNotNull(loop)),
       name_(nameArg),
       state_(kConnecting),
-      // reading_(true),
+      reading_(true),
       socket_(new Socket(sockfd)),
       channel_(new Channel(loop, sockfd)),
       localAddr_(localAddr),
       peerAddr_(peerAddr),
-      highWaterMark_(64 * 1024 * 1024) {
+      highWaterMark_(64 * 1024 * 1024),
+      lowWaterMark_(0),
+      aboveHighWaterMark_(false),
+      outputLimit_(0),
+      outputOverflowPolicy_(kDropSend),
+      droppedSends_(0),
+      edgeTriggered_(false),
+      corked_(false),
+      inputHighWaterMark_(0),
+      inputLowWaterMark_(0),
+      inputBacklog_(0),
+      readThrottled_(false),
+      flushPending_(false),
+      outboundScheduled_(false),
+      drainingOutbound_(false),
+      zeroCopyState_(kZeroCopyUnknown),
+      zeroCopySeq_(0),
+      idleTimeout_(0.0),
+      readTimeout_(0.0),
+      idleTimer_(std::bind(&TcpConnection::handleIdleTimeout, this)),
+      readTimer_(std::bind(&TcpConnection::handleReadTimeout, this)),
+      trimTimer_(std::bind(&TcpConnection::handleTrimTimeout, this)) {
+  loop_->incConnectionCount();
+  channel_->setName(name_);
   channel_->setReadCallback(
       std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
   channel_->setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
@@ -56,6 +130,15 @@ TcpConnection::TcpConnection(EventLoop* loop, const std::string& nameArg,
 }
 
 TcpConnection::~TcpConnection() {
+  loop_->decConnectionCount();
+  while (Outbound* message = outbound_.pop()) {
+    delete message;
+  }
+  for (const OutputSegment& segment : segments_) {
+    if (segment.fileFd >= 0) {
+      ::close(segment.fileFd);
+    }
+  }
   LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d\n", name_.c_str(),
            channel_->fd(), (int)state_);
 }
@@ -65,9 +148,17 @@ void TcpConnection::send(const std::string& buf) {
     if (loop_->isInLoopThread()) {
       sendInLoop(buf.c_str(), buf.size());
     } else {
-      void (TcpConnection::*fp)(const char* data, std::size_t len) =
-          &TcpConnection::sendInLoop;
-      loop_->runInLoop(std::bind(fp, this, buf.c_str(), buf.size()));
+      queueOutbound(new Outbound(std::string(buf)));
+    }
+  }
+}
+
+void TcpConnection::send(std::string&& message) {
+  if (state_ == kConnected) {
+    if (loop_->isInLoopThread()) {
+      sendInLoop(message.data(), message.size());
+    } else {
+      queueOutbound(new Outbound(std::move(message)));
     }
   }
 }
@@ -78,18 +169,78 @@ void TcpConnection::send(Buffer* buf) {
       sendInLoop(buf->peek(), buf->readableBytes());
       buf->retrieveAll();
     } else {
-      void (TcpConnection::*fp)(const std::string& message) =
-          &TcpConnection::sendInLoop;
-      loop_->runInLoop(std::bind(fp, this, buf->retrieveAllAsString()));
+      queueOutbound(new Outbound(std::move(*buf)));
+    }
+  }
+}
+
+void TcpConnection::send(Buffer&& message) { send(&message); }
+
+// 生产者先入队再检查标志，drainOutbound先清除标志再出队：
+// 任何drainOutbound没有取到的消息，其生产者一定会再投递一次
+void TcpConnection::queueOutbound(Outbound* message) {
+  outbound_.push(message);
+  if (!outboundScheduled_.exchange(true, std::memory_order_acq_rel)) {
+    loop_->queueInLoop(
+        std::bind(&TcpConnection::drainOutbound, shared_from_this()));
+  }
+}
+
+void TcpConnection::drainOutbound() {
+  loop_->assertInLoopThread();
+  outboundScheduled_.exchange(false, std::memory_order_acq_rel);
+  drainingOutbound_ = true;
+  while (Outbound* message = outbound_.pop()) {
+    switch (message->kind) {
+      case Outbound::kSlice:
+        // 写不完的部分按引用留在输出缓冲区，不再拷贝
+        if (!message->slice.empty()) {
+          sendSliceInLoop(message->slice);
+        }
+        break;
+      case Outbound::kBuffer:
+        if (message->buffer.readableBytes() > 0) {
+          sendInLoop(message->buffer.peek(), message->buffer.readableBytes());
+        }
+        break;
+      case Outbound::kZeroCopy:
+        sendZeroCopyInLoop(message->payload);
+        break;
+      case Outbound::kFile:
+        sendFileInLoop(message->fileFd, message->fileOffset,
+                       message->fileLength);
+        message->fileFd = -1;  // 已交给sendFileInLoop
+        break;
     }
+    delete message;
+  }
+  drainingOutbound_ = false;
+  if (state_ == kDisconnecting) {
+    shutdownInLoop();
   }
 }
 
-void TcpConnection::sendInLoop(const std::string& message) {
-  sendInLoop(message.data(), message.size());
+void TcpConnection::send(const Slice& slice) {
+  if (state_ == kConnected) {
+    if (loop_->isInLoopThread()) {
+      sendSliceInLoop(slice);
+    } else {
+      queueOutbound(new Outbound(slice));
+    }
+  }
 }
 
 void TcpConnection::sendInLoop(const char* data, std::size_t len) {
+  sendInLoop(data, len, nullptr);
+}
+
+void TcpConnection::sendSliceInLoop(const Slice& slice) {
+  sendInLoop(slice.data(), slice.size(), &slice);
+}
+
+// slice非空时data就是它的数据，未能立即写出的部分按引用追加到输出缓冲区
+void TcpConnection::sendInLoop(const char* data, std::size_t len,
+                               const Slice* slice) {
   loop_->assertInLoopThread();
   ssize_t nwrote = 0;
   std::size_t remaining = len;
@@ -99,10 +250,32 @@ void TcpConnection::sendInLoop(const char* data, std::size_t len) {
     LOG_ERROR("disconnected, give up writing");
     return;
   }
+  if (!admitOutput(len)) {
+    return;
+  }
 
-  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
+  // 合并发送模式下先攒在输出缓冲区，本轮循环结束时统一发送
+  if (corked_) {
+    std::size_t oldlen = pendingOutputBytes();
+    appendOutput(data, len, slice, 0);
+    checkHighWaterMark(oldlen);
+    scheduleFlush();
+    return;
+  }
+
+  if (outputDrained()) {
     nwrote = ::write(channel_->fd(), data, len);
+    // 边缘触发模式下写到EAGAIN为止，剩余的数据等待下一个EPOLLOUT边沿
+    while (edgeTriggered_ && nwrote > 0 &&
+           static_cast<std::size_t>(nwrote) < len) {
+      ssize_t n = ::write(channel_->fd(), data + nwrote, len - nwrote);
+      if (n <= 0) {
+        break;
+      }
+      nwrote += n;
+    }
     if (nwrote >= 0) {
+      touchIdleTimer();
       remaining = len - nwrote;
       if (remaining == 0 && writeCompleteCallback_) {
         loop_->queueInLoop(
@@ -120,19 +293,293 @@ void TcpConnection::sendInLoop(const char* data, std::size_t len) {
   }
 
   if (!faultError && remaining > 0) {
-    std::size_t oldlen = outputBuffer_.readableBytes();
-    if (oldlen + remaining >= highWaterMark_ && oldlen < highWaterMark_ &&
-        highWaterMarkCallback_) {
-      loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(),
-                                   oldlen + remaining));
-    }
-    outputBuffer_.append(static_cast<const char*>(data) + nwrote, remaining);
+    std::size_t oldlen = pendingOutputBytes();
+    appendOutput(data, len, slice, nwrote);
+    checkHighWaterMark(oldlen);
     if (!channel_->isWriting()) {
       channel_->enableWriting();
     }
   }
 }
 
+void TcpConnection::appendOutput(const char* data, std::size_t len,
+                                 const Slice* slice, std::size_t offset) {
+  if (slice != nullptr) {
+    outputBuffer_.append(slice->subslice(offset));
+  } else {
+    outputBuffer_.append(data + offset, len - offset);
+  }
+}
+
+void TcpConnection::sendZeroCopy(ZeroCopyPayload payload) {
+  if (state_ == kConnected) {
+    if (loop_->isInLoopThread()) {
+      sendZeroCopyInLoop(payload);
+    } else {
+      queueOutbound(new Outbound(std::move(payload)));
+    }
+  }
+}
+
+void TcpConnection::sendZeroCopyInLoop(const ZeroCopyPayload& payload) {
+  loop_->assertInLoopThread();
+  if (state_ == kDisconnected) {
+    LOG_ERROR("disconnected, give up writing");
+    return;
+  }
+  if (zeroCopyState_ == kZeroCopyUnknown) {
+    zeroCopyState_ = socket_->setZeroCopy(true) ? kZeroCopyOn : kZeroCopyOff;
+  }
+  // 小负载固定page和接收完成通知的开销比拷贝还大
+  if (payload->size() < kZeroCopyThreshold || zeroCopyState_ != kZeroCopyOn) {
+    sendInLoop(payload->data(), payload->size());
+    return;
+  }
+  if (!admitOutput(payload->size())) {
+    return;
+  }
+
+  OutputSegment segment;
+  segment.payload = payload;
+  appendSegment(std::move(segment));
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, std::size_t length) {
+  if (state_ != kConnected || length == 0) {
+    return;
+  }
+  // 只接受普通文件，管道、socket等的sendfile会一直失败
+  struct stat st;
+  if (::fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+    LOG_ERROR("TcpConnection::sendFile fd:%d is not a regular file\n", fd);
+    return;
+  }
+  int fileFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (fileFd < 0) {
+    LOG_ERROR("TcpConnection::sendFile dup fd:%d error:%d\n", fd, errno);
+    return;
+  }
+  if (loop_->isInLoopThread()) {
+    sendFileInLoop(fileFd, offset, length);
+  } else {
+    queueOutbound(new Outbound(fileFd, offset, length));
+  }
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, std::size_t length) {
+  loop_->assertInLoopThread();
+  if (state_ == kDisconnected) {
+    LOG_ERROR("disconnected, give up writing");
+    ::close(fd);
+    return;
+  }
+  if (!admitOutput(length)) {
+    ::close(fd);
+    return;
+  }
+  OutputSegment segment;
+  segment.fileFd = fd;
+  segment.fileOffset = offset;
+  segment.fileRemaining = length;
+  appendSegment(std::move(segment));
+}
+
+// 排在新segment前面的是outputBuffer_中尚未归属任何segment的数据
+void TcpConnection::appendSegment(OutputSegment segment) {
+  std::size_t oldlen = pendingOutputBytes();
+  std::size_t bufferedBefore = outputBuffer_.readableBytes();
+  for (const OutputSegment& queued : segments_) {
+    bufferedBefore -= queued.bufferedBefore;
+  }
+  segment.bufferedBefore = bufferedBefore;
+  segments_.push_back(std::move(segment));
+  checkHighWaterMark(oldlen);
+
+  if (corked_) {
+    scheduleFlush();
+  } else {
+    flushInLoop();
+  }
+}
+
+// 发完的segment：文件随即关闭，内核仍引用的零拷贝负载等待完成通知
+void TcpConnection::popSegment() {
+  OutputSegment& segment = segments_.front();
+  if (segment.fileFd >= 0) {
+    ::close(segment.fileFd);
+  } else if (segment.pinned) {
+    zeroCopyInflight_.push_back(std::move(segment));
+  }
+  segments_.pop_front();
+}
+
+/**
+ * 按顺序发送outputBuffer_中的数据与segments_中的负载和文件。
+ * 水平触发模式下遇到写不完就停止，边缘触发模式下写到全部发完或EAGAIN为止。
+ * 返回写出的总字节数，一个字节都没写出时返回最后一次写的结果。
+ */
+ssize_t TcpConnection::writeOutput(int* savedErrno) {
+  ssize_t total = 0;
+  while (!outputEmpty()) {
+    ssize_t n = 0;
+    std::size_t want = 0;
+    if (segments_.empty() || segments_.front().bufferedBefore > 0) {
+      want = segments_.empty() ? outputBuffer_.readableBytes()
+                               : segments_.front().bufferedBefore;
+      n = outputBuffer_.writeFd(channel_->fd(), savedErrno, want);
+      if (n > 0) {
+        outputBuffer_.retrieve(n);
+        if (!segments_.empty()) {
+          segments_.front().bufferedBefore -= n;
+        }
+      }
+    } else if (segments_.front().fileFd >= 0) {
+      OutputSegment& segment = segments_.front();
+      want = std::min(segment.fileRemaining, kMaxSendFileChunk);
+      n = ::sendfile(channel_->fd(), segment.fileFd, &segment.fileOffset,
+                     want);
+      if (n < 0 && errno == EAGAIN) {
+        *savedErrno = errno;
+      } else if (n <= 0) {
+        // 文件读取出错或比约定的长度短，对端收到的数据已不完整，
+        // 留在队首还会挡住之后的所有输出，只能关闭连接
+        *savedErrno = n < 0 ? errno : EIO;
+        LOG_ERROR("TcpConnection::sendFile [%s] %lu bytes unsent, error:%d\n",
+                  name_.c_str(), segment.fileRemaining, *savedErrno);
+        popSegment();
+        forceClose();
+        n = -1;
+      } else {
+        segment.fileRemaining -= n;
+        if (segment.fileRemaining == 0) {
+          popSegment();
+        }
+      }
+    } else {
+      OutputSegment& segment = segments_.front();
+      const char* data = segment.payload->data() + segment.offset;
+      want = segment.payload->size() - segment.offset;
+      bool pinned = zeroCopyState_ == kZeroCopyOn;
+      n = ::send(channel_->fd(), data, want,
+                 MSG_NOSIGNAL | (pinned ? MSG_ZEROCOPY : 0));
+      // 待完成的通知占满了optmem时退回普通发送
+      if (n < 0 && errno == ENOBUFS && pinned) {
+        pinned = false;
+        n = ::send(channel_->fd(), data, want, MSG_NOSIGNAL);
+      }
+      if (n < 0) {
+        *savedErrno = errno;
+      } else if (n > 0) {
+        segment.offset += n;
+        if (pinned) {
+          // 每次成功的MSG_ZEROCOPY发送占用一个完成通知的序号
+          segment.pinned = true;
+          segment.lastSeq = zeroCopySeq_++;
+        }
+        if (segment.offset == segment.payload->size()) {
+          popSegment();
+        }
+      }
+    }
+    if (n <= 0) {
+      return total > 0 ? total : n;
+    }
+    total += n;
+    if (!edgeTriggered_ && static_cast<std::size_t>(n) < want) {
+      break;
+    }
+  }
+  return total;
+}
+
+/**
+ * 从socket错误队列读取MSG_ZEROCOPY的完成通知，释放内核已用完的负载。
+ * 通知的[ee_info, ee_data]是完成的发送序号范围，TCP按序完成。
+ */
+bool TcpConnection::reapZeroCopy() {
+  bool reaped = false;
+  for (;;) {
+    char control[128];
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (::recvmsg(channel_->fd(), &msg, MSG_ERRQUEUE) < 0) {
+      break;
+    }
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr;
+         cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+          !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+        continue;
+      }
+      const struct sock_extended_err* err =
+          reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+      if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+      reaped = true;
+      // 内核最终还是拷贝了数据（如回环地址），之后直接走普通发送
+      if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+        zeroCopyState_ = kZeroCopyOff;
+      }
+      while (!zeroCopyInflight_.empty() &&
+             static_cast<int32_t>(zeroCopyInflight_.front().lastSeq -
+                                  err->ee_data) <= 0) {
+        zeroCopyInflight_.pop_front();
+      }
+    }
+  }
+  if (reaped && state_ == kDisconnecting) {
+    shutdownInLoop();
+  }
+  return reaped;
+}
+
+void TcpConnection::scheduleFlush() {
+  if (!flushPending_) {
+    flushPending_ = true;
+    loop_->runAtIterationEnd(
+        std::bind(&TcpConnection::flushInLoop, shared_from_this()));
+  }
+}
+
+void TcpConnection::flush() {
+  loop_->runInLoop(
+      std::bind(&TcpConnection::flushInLoop, shared_from_this()));
+}
+
+// 把积压的数据用writev发出，发不完的部分交给写事件继续
+void TcpConnection::flushInLoop() {
+  loop_->assertInLoopThread();
+  flushPending_ = false;
+  if (state_ == kDisconnected || outputEmpty() ||
+      (!edgeTriggered_ && channel_->isWriting())) {
+    return;
+  }
+
+  int savedErrno = 0;
+  ssize_t n = writeOutput(&savedErrno);
+  if (n > 0) {
+    touchIdleTimer();
+    checkLowWaterMark();
+  } else if (savedErrno != EWOULDBLOCK) {
+    LOG_ERROR("TcpConnection::flushInLoop");
+    return;
+  }
+
+  if (outputEmpty()) {
+    if (writeCompleteCallback_) {
+      loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+    }
+    if (state_ == kDisconnecting) {
+      shutdownInLoop();
+    }
+  } else if (!edgeTriggered_) {
+    channel_->enableWriting();
+  }
+}
+
 void TcpConnection::shutdown() {
   if (state_ == kConnected) {
     setState(kDisconnecting);
@@ -156,17 +603,106 @@ void TcpConnection::forceCloseInLoop() {
 }
 
 void TcpConnection::shutdownInLoop() {
-  if (!channel_->isWriting())  // 说明当前outputBuffer_的数据全部向外发送完成
-  {
+  // 数据全部向外发送完成，并且内核不再引用零拷贝的负载。
+  // 其他线程在shutdown之前交给outbound_的输出还没取完时，由drainOutbound再调用
+  if (outputDrained() && zeroCopyInflight_.empty() && !drainingOutbound_ &&
+      !outboundScheduled_.load(std::memory_order_acquire)) {
     socket_->shutdownWrite();
   }
 }
 
+// 水平触发模式下写事件只在有待发送数据时注册，边缘触发模式下写事件常驻
+bool TcpConnection::outputDrained() const {
+  if (edgeTriggered_) {
+    return outputEmpty();
+  }
+  return !channel_->isWriting() && outputEmpty();
+}
+
+bool TcpConnection::outputEmpty() const {
+  return outputBuffer_.readableBytes() == 0 && segments_.empty();
+}
+
+std::size_t TcpConnection::pendingOutputBytes() const {
+  std::size_t bytes = outputBuffer_.readableBytes();
+  for (const OutputSegment& segment : segments_) {
+    bytes += segment.fileFd >= 0 ? segment.fileRemaining
+                                 : segment.payload->size() - segment.offset;
+  }
+  return bytes;
+}
+
+// 超过输出上限的消息整条拒绝，截断会破坏对端看到的字节流
+bool TcpConnection::admitOutput(std::size_t len) {
+  if (outputLimit_ == 0 || len == 0) {
+    return true;
+  }
+  std::size_t pending = pendingOutputBytes();
+  if (pending + len <= outputLimit_) {
+    return true;
+  }
+  ++droppedSends_;
+  LOG_WARN("TcpConnection [%s] output limit %lu exceeded, pending=%lu "
+           "len=%lu\n",
+           name_.c_str(), outputLimit_, pending, len);
+  if (outputOverflowPolicy_ == kCloseConnection) {
+    forceClose();
+  }
+  return false;
+}
+
+// oldlen为这次追加之前的待发送字节数
+void TcpConnection::checkHighWaterMark(std::size_t oldlen) {
+  std::size_t newlen = pendingOutputBytes();
+  if (oldlen < highWaterMark_ && newlen >= highWaterMark_) {
+    aboveHighWaterMark_ = true;
+    if (highWaterMarkCallback_) {
+      loop_->queueInLoop(
+          std::bind(highWaterMarkCallback_, shared_from_this(), newlen));
+    }
+  }
+}
+
+void TcpConnection::checkLowWaterMark() {
+  if (!aboveHighWaterMark_) {
+    return;
+  }
+  std::size_t pending = pendingOutputBytes();
+  if (pending <= lowWaterMark_) {
+    aboveHighWaterMark_ = false;
+    if (lowWaterMarkCallback_) {
+      loop_->queueInLoop(
+          std::bind(lowWaterMarkCallback_, shared_from_this(), pending));
+    }
+  }
+}
+
+void TcpConnection::setNotSentLowat(unsigned int bytes) {
+  socket_->setNotSentLowat(bytes);
+}
+
 // 连接建立
 void TcpConnection::connectEstablished() {
   setState(kConnected);
   channel_->tie(shared_from_this());
-  channel_->enableReading();
+  if (edgeTriggered_ && !loop_->edgeTriggeredSupported()) {
+    LOG_WARN("TcpConnection [%s] poller has no edge-triggered mode\n",
+             name_.c_str());
+    edgeTriggered_ = false;
+  }
+  if (edgeTriggered_) {
+    channel_->setEdgeTriggered(true);
+    channel_->enableWriting();
+  }
+  if (reading_) {
+    channel_->enableReading();
+  }
+  touchIdleTimer();
+
+  // 所属的循环处于忙轮询模式时，socket也在接收路径上忙轮询
+  if (loop_->busyPollUs() > 0) {
+    socket_->setBusyPoll(static_cast<int>(loop_->busyPollUs()));
+  }
 
   // 新连接建立 执行回调
   connectionCallback_(shared_from_this());
@@ -174,6 +710,7 @@ void TcpConnection::connectEstablished() {
 
 // 连接销毁
 void TcpConnection::connectDestroyed() {
+  cancelTimers();
   if (state_ == kConnected) {
     setState(kDisconnected);
     channel_->disableAll();
@@ -185,12 +722,34 @@ void TcpConnection::connectDestroyed() {
 void TcpConnection::handleRead(Timestamp receiveTime) {
   LOG_DEBUG("TcpConnection -> handleRead");
   loop_->assertInLoopThread();
+  // 同一轮事件中已被暂停读取
+  if (!channel_->isReading()) {
+    return;
+  }
   int savedErrno = 0;
-  ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+  ssize_t n = 0;
+  // 边缘触发模式下必须读到EAGAIN，否则剩余的数据不会再次通知
+  do {
+    // 先读到循环共享的scratch中，回调处理不完的部分才留在inputBuffer_里
+    n = inputBuffer_.readFd(channel_->fd(), &savedErrno, loop_->readScratch(),
+                            EventLoop::kReadScratchSize);
+    if (n > 0) {
+      touchIdleTimer();
+      messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+      inputBuffer_.returnScratch();
+      updateReadTimer();
+      updateTrimTimer();
+      updateReadThrottle();
+    }
+  } while (edgeTriggered_ && n > 0 && state_ != kDisconnected &&
+           channel_->isReading());
+
   if (n > 0) {
-    messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    return;
   } else if (n == 0) {
     handleClose();
+  } else if (edgeTriggered_ && savedErrno == EAGAIN) {
+    return;
   } else {
     errno = savedErrno;
     LOG_ERROR("TcpConnection::handleRead");
@@ -198,15 +757,101 @@ void TcpConnection::handleRead(Timestamp receiveTime) {
   }
 }
 
+void TcpConnection::startRead() {
+  loop_->runInLoop(
+      std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::stopRead() {
+  loop_->runInLoop(
+      std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::startReadInLoop() {
+  loop_->assertInLoopThread();
+  reading_ = true;
+  updateReading();
+}
+
+void TcpConnection::stopReadInLoop() {
+  loop_->assertInLoopThread();
+  reading_ = false;
+  updateReading();
+}
+
+void TcpConnection::setInputWatermarks(std::size_t highWaterMark,
+                                       std::size_t lowWaterMark) {
+  inputHighWaterMark_ = highWaterMark;
+  inputLowWaterMark_.store(std::min(lowWaterMark, highWaterMark),
+                           std::memory_order_relaxed);
+  updateReadThrottle();
+}
+
+// 积压量上升时由下一次读之后的检查负责暂停，这里只需要在可能恢复时通知循环
+void TcpConnection::setInputBacklog(std::size_t bytes) {
+  inputBacklog_.store(bytes, std::memory_order_relaxed);
+  if (readThrottled_.load(std::memory_order_acquire) &&
+      bytes <= inputLowWaterMark_.load(std::memory_order_relaxed)) {
+    loop_->runInLoop(
+        std::bind(&TcpConnection::updateReadThrottle, shared_from_this()));
+  }
+}
+
+void TcpConnection::updateReadThrottle() {
+  loop_->assertInLoopThread();
+  std::size_t level = inputBuffer_.readableBytes() +
+                      inputBacklog_.load(std::memory_order_relaxed);
+  bool throttled = readThrottled_.load(std::memory_order_relaxed);
+  if (!throttled && inputHighWaterMark_ > 0 && level >= inputHighWaterMark_) {
+    LOG_DEBUG("TcpConnection [%s] pause reading, %lu bytes pending",
+              name_.c_str(), level);
+    readThrottled_.store(true, std::memory_order_release);
+  } else if (throttled &&
+             (inputHighWaterMark_ == 0 ||
+              level <= inputLowWaterMark_.load(std::memory_order_relaxed))) {
+    LOG_DEBUG("TcpConnection [%s] resume reading, %lu bytes pending",
+              name_.c_str(), level);
+    readThrottled_.store(false, std::memory_order_release);
+  } else {
+    return;
+  }
+  updateReading();
+}
+
+// 读事件开启当且仅当使用者允许读取并且没有被反压暂停
+void TcpConnection::updateReading() {
+  if (state_ != kConnected && state_ != kDisconnecting) {
+    return;
+  }
+  bool want = reading_ && !readThrottled_.load(std::memory_order_relaxed);
+  if (want && !channel_->isReading()) {
+    channel_->enableReading();
+    // 边缘触发模式下暂停期间到达的数据不会再产生边沿，主动读一次
+    if (edgeTriggered_) {
+      loop_->queueInLoop(std::bind(&TcpConnection::handleRead,
+                                   shared_from_this(), Timestamp::now()));
+    }
+  } else if (!want && channel_->isReading()) {
+    channel_->disableReading();
+  }
+}
+
 void TcpConnection::handleWrite() {
   LOG_DEBUG("TcpConnection -> handleWrite");
+  if (edgeTriggered_ && outputEmpty()) {
+    return;  // 边缘触发模式下写事件常驻，没有待发送的数据
+  }
   if (channel_->isWriting()) {
     int savedErrno = 0;
-    ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
-    if (n > 0) {
-      outputBuffer_.retrieve(n);
-      if (outputBuffer_.readableBytes() == 0) {
-        channel_->disableWriting();
+    // 边缘触发模式下写到全部发完或EAGAIN为止
+    ssize_t n = writeOutput(&savedErrno);
+    if (n > 0 || (edgeTriggered_ && savedErrno == EAGAIN)) {
+      touchIdleTimer();
+      checkLowWaterMark();
+      if (outputEmpty()) {
+        if (!edgeTriggered_) {
+          channel_->disableWriting();
+        }
         if (writeCompleteCallback_) {
           loop_->queueInLoop(
               std::bind(writeCompleteCallback_, shared_from_this()));
@@ -228,13 +873,98 @@ void TcpConnection::handleClose() {
            (int)state_);
   setState(kDisconnected);
   channel_->disableAll();
+  cancelTimers();
 
   TcpConnectionPtr connPtr(shared_from_this());
   connectionCallback_(connPtr);  // 执行连接关闭的回调
   closeCallback_(connPtr);
 }
 
+void TcpConnection::setIdleTimeout(double seconds) {
+  loop_->runInLoop(std::bind(&TcpConnection::setIdleTimeoutInLoop,
+                             shared_from_this(), seconds));
+}
+
+void TcpConnection::setReadTimeout(double seconds) {
+  loop_->runInLoop(std::bind(&TcpConnection::setReadTimeoutInLoop,
+                             shared_from_this(), seconds));
+}
+
+void TcpConnection::setIdleTimeoutInLoop(double seconds) {
+  loop_->assertInLoopThread();
+  idleTimeout_ = seconds;
+  if (idleTimeout_ > 0.0) {
+    touchIdleTimer();
+  } else {
+    loop_->timingWheel()->cancel(&idleTimer_);
+  }
+}
+
+void TcpConnection::setReadTimeoutInLoop(double seconds) {
+  loop_->assertInLoopThread();
+  readTimeout_ = seconds;
+  loop_->timingWheel()->cancel(&readTimer_);
+  updateReadTimer();
+}
+
+// 每次有读写进展时重新计时，时间轮上只是O(1)的链表操作
+void TcpConnection::touchIdleTimer() {
+  if (idleTimeout_ > 0.0 && state_ == kConnected) {
+    loop_->timingWheel()->arm(&idleTimer_, idleTimeout_);
+  }
+}
+
+// 读超时从输入缓冲区变为非空时开始计时，后续的读不会重置它
+void TcpConnection::updateReadTimer() {
+  if (readTimeout_ <= 0.0 || state_ != kConnected) {
+    return;
+  }
+  if (inputBuffer_.readableBytes() == 0) {
+    loop_->timingWheel()->cancel(&readTimer_);
+  } else if (!readTimer_.armed()) {
+    loop_->timingWheel()->arm(&readTimer_, readTimeout_);
+  }
+}
+
+void TcpConnection::cancelTimers() {
+  loop_->timingWheel()->cancel(&idleTimer_);
+  loop_->timingWheel()->cancel(&readTimer_);
+  loop_->timingWheel()->cancel(&trimTimer_);
+}
+
+// 每次读到数据都重新计时，连接持续活跃时不收缩
+void TcpConnection::updateTrimTimer() {
+  if (inputBuffer_.internalCapacity() > kTrimThreshold &&
+      state_ == kConnected) {
+    loop_->timingWheel()->arm(&trimTimer_, kTrimDelay);
+  } else if (trimTimer_.armed()) {
+    loop_->timingWheel()->cancel(&trimTimer_);
+  }
+}
+
+void TcpConnection::handleTrimTimeout() {
+  LOG_DEBUG("TcpConnection::handleTrimTimeout [%s] shrink %lu bytes buffer",
+            name_.c_str(), inputBuffer_.internalCapacity());
+  inputBuffer_.shrink();
+}
+
+void TcpConnection::handleIdleTimeout() {
+  LOG_INFO("TcpConnection::handleIdleTimeout [%s] idle for %.1f seconds\n",
+           name_.c_str(), idleTimeout_);
+  forceClose();
+}
+
+void TcpConnection::handleReadTimeout() {
+  LOG_INFO(
+      "TcpConnection::handleReadTimeout [%s] %lu unconsumed bytes after %.1f "
+      "seconds\n",
+      name_.c_str(), inputBuffer_.readableBytes(), readTimeout_);
+  forceClose();
+}
+
 void TcpConnection::handleError() {
+  // 错误队列中可能是零拷贝发送的完成通知，同一个EPOLLERR也可能带着真正的错误
+  bool reaped = zeroCopyState_ != kZeroCopyUnknown && reapZeroCopy();
   int optval;
   socklen_t optlen = sizeof optval;
   int err = 0;
@@ -244,6 +974,9 @@ void TcpConnection::handleError() {
   } else {
     err = optval;
   }
+  if (err == 0 && reaped) {
+    return;
+  }
   LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d\n", name_.c_str(),
             err);
 }
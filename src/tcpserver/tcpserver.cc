@@ -3,7 +3,9 @@
 #include <string.h>
 #include "assert.h"
 
+#include <condition_variable>
 #include <functional>
+#include <mutex>
 
 #include "tcpserver/tcpconnection.h"
 #include "util/log.h"
@@ -22,18 +24,30 @@ TcpServer::TcpServer(EventLoop* loop, const InetAddress& listenAddr,
     : loop_(CheckLoopNotNull(loop)),
       ipPort_(listenAddr.toIpPort()),
       name_(nameArg),
-      acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+      listenAddr_(listenAddr),
+      acceptorPerLoop_(option == kReusePortPerLoop),
+      acceptBatch_(0),
+      acceptor_(acceptorPerLoop_
+                    ? nullptr
+                    : new Acceptor(loop, listenAddr, option != kNoReusePort)),
       threadPool_(new EventLoopThreadPool(loop, name_)),
       connectionCallback_(),
       messageCallback_(),
       nextConnId_(1),
-      started_(0) {
-  acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this,
-                                                std::placeholders::_1,
-                                                std::placeholders::_2));
+      started_(0),
+      edgeTriggered_(false) {
+  if (acceptor_) {
+    acceptor_->setNewConnectionCallback(
+        std::bind(&TcpServer::newConnection, this, std::placeholders::_1,
+                  std::placeholders::_2));
+    listenAddr_ = acceptor_->listenAddress();
+    ipPort_ = listenAddr_.toIpPort();
+  }
 }
 
 TcpServer::~TcpServer() {
+  stopLoopAcceptors();
+
   for (auto& item : connections_) {
     TcpConnectionPtr conn(item.second);
     item.second.reset();
@@ -43,8 +57,32 @@ TcpServer::~TcpServer() {
   }
 }
 
-void TcpServer::setThreadNum(int numThreads) {
+void TcpServer::setThreadNum(int numThreads, const CpuAffinity& affinity) {
   threadPool_->setThreadNum(numThreads);
+  threadPool_->setAffinity(affinity);
+}
+
+void TcpServer::setAcceptBatch(int batch) {
+  acceptBatch_ = batch;
+  if (acceptor_) {
+    acceptor_->setAcceptBatch(batch);
+  }
+}
+
+void TcpServer::setLoadBalance(EventLoopThreadPool::LoadBalance loadBalance) {
+  threadPool_->setLoadBalance(loadBalance);
+}
+
+// ListenOverflows是主机级别的计数器，所有Acceptor合计后只读一次
+AcceptStats TcpServer::acceptStats() const {
+  AcceptStats stats = acceptor_ ? acceptor_->stats() : AcceptStats();
+  for (const auto& loopAcceptor : loopAcceptors_) {
+    if (loopAcceptor->acceptor) {
+      stats += loopAcceptor->acceptor->stats();
+    }
+  }
+  Acceptor::readListenOverflows(&stats);
+  return stats;
 }
 
 // 开启服务器监听
@@ -52,17 +90,75 @@ void TcpServer::start() {
   if (started_++ == 0)  // 防止一个TcpServer对象被start多次
   {
     threadPool_->start(threadInitCallback_);  // 启动底层的loop线程池
-    assert(!acceptor_->listenning());
-    loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+    if (acceptorPerLoop_) {
+      startLoopAcceptors();
+    } else {
+      assert(!acceptor_->listenning());
+      loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+    }
   }
 }
 
-void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr) {
-  // 轮询算法 选择一个subLoop 来管理connfd对应的channel
-  EventLoop* ioLoop = threadPool_->getNextLoop();
+// 端口为0时第一个Acceptor绑定后取回内核分配的端口，其余的绑定同一个端口
+void TcpServer::startLoopAcceptors() {
+  for (EventLoop* ioLoop : threadPool_->getAllLoops()) {
+    LoopAcceptor* loopAcceptor = new LoopAcceptor;
+    loopAcceptor->loop = ioLoop;
+    loopAcceptor->acceptor.reset(new Acceptor(ioLoop, listenAddr_, true));
+    if (loopAcceptors_.empty()) {
+      listenAddr_ = loopAcceptor->acceptor->listenAddress();
+      ipPort_ = listenAddr_.toIpPort();
+    }
+    if (acceptBatch_ > 0) {
+      loopAcceptor->acceptor->setAcceptBatch(acceptBatch_);
+    }
+    loopAcceptor->acceptor->setNewConnectionCallback(
+        std::bind(&TcpServer::newLoopConnection, this, loopAcceptor,
+                  std::placeholders::_1, std::placeholders::_2));
+    loopAcceptors_.push_back(std::unique_ptr<LoopAcceptor>(loopAcceptor));
+    ioLoop->runInLoop(
+        std::bind(&Acceptor::listen, loopAcceptor->acceptor.get()));
+  }
+}
+
+// 每个loop的监听器与连接都在各自的loop线程中销毁，等待全部完成后才返回，
+// 之后不会再有回调进入本TcpServer。已经停止的loop不会再执行队列中的回调，
+// 直接在当前线程中销毁
+void TcpServer::stopLoopAcceptors() {
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::size_t remaining = loopAcceptors_.size();
+
+  for (auto& item : loopAcceptors_) {
+    LoopAcceptor* loopAcceptor = item.get();
+    auto stop = [loopAcceptor, &mutex, &cond, &remaining] {
+      loopAcceptor->acceptor.reset();
+      for (auto& conn : loopAcceptor->connections) {
+        conn.second->connectDestroyed();
+      }
+      loopAcceptor->connections.clear();
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--remaining == 0) {
+        cond.notify_one();
+      }
+    };
+    EventLoop* ioLoop = loopAcceptor->loop;
+    if (ioLoop->isInLoopThread() || !ioLoop->looping()) {
+      stop();
+    } else {
+      ioLoop->queueInLoop(stop);
+    }
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock, [&remaining] { return remaining == 0; });
+}
+
+TcpConnectionPtr TcpServer::createConnection(EventLoop* ioLoop, int sockfd,
+                                             const InetAddress& peerAddr) {
   char buf[64] = {0};
-  snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_);
-  ++nextConnId_;
+  snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_++);
   std::string connName = name_ + buf;
 
   sockaddr_in local;
@@ -79,10 +175,20 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr) {
   LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s\n",
            name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
 
-  connections_[connName] = conn;
   conn->setConnectionCallback(connectionCallback_);
   conn->setMessageCallback(messageCallback_);
   conn->setWriteCompleteCallback(writeCompleteCallback_);
+  conn->setEdgeTriggered(edgeTriggered_);
+  return conn;
+}
+
+void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr) {
+  // 按负载均衡策略选择一个subLoop来管理connfd对应的channel，
+  // 一致性哈希只使用对端IP，同一客户端的连接落在同一个subLoop上
+  EventLoop* ioLoop =
+      threadPool_->getNextLoop(peerAddr.getSockAddr()->sin_addr.s_addr);
+  TcpConnectionPtr conn = createConnection(ioLoop, sockfd, peerAddr);
+  connections_[conn->name()] = conn;
 
   // close down
   conn->setCloseCallback(
@@ -91,6 +197,28 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr) {
   ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
 }
 
+// 在loopAcceptor所属的loop线程中执行，连接的建立与销毁都不跨线程
+void TcpServer::newLoopConnection(LoopAcceptor* loopAcceptor, int sockfd,
+                                  const InetAddress& peerAddr) {
+  TcpConnectionPtr conn =
+      createConnection(loopAcceptor->loop, sockfd, peerAddr);
+  loopAcceptor->connections[conn->name()] = conn;
+
+  conn->setCloseCallback(std::bind(&TcpServer::removeLoopConnection, this,
+                                   loopAcceptor, std::placeholders::_1));
+  conn->connectEstablished();
+}
+
+void TcpServer::removeLoopConnection(LoopAcceptor* loopAcceptor,
+                                     const TcpConnectionPtr& conn) {
+  LOG_INFO("TcpServer::removeLoopConnection [%s] - connection %s\n",
+           name_.c_str(), conn->name().c_str());
+
+  loopAcceptor->connections.erase(conn->name());
+  loopAcceptor->loop->queueInLoop(
+      std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
 void TcpServer::removeConnection(const TcpConnectionPtr& conn) {
   loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
 }
@@ -0,0 +1,227 @@
+#include "thread/cpuaffinity.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "util/log.h"
+
+namespace Tnet {
+
+static const int kMaxNumaNodes = 1024;
+
+static bool readFile(const std::string& path, std::string* content) {
+  FILE* fp = ::fopen(path.c_str(), "r");
+  if (fp == nullptr) {
+    return false;
+  }
+  char buf[4096];
+  size_t n = ::fread(buf, 1, sizeof(buf) - 1, fp);
+  ::fclose(fp);
+  content->assign(buf, n);
+  return true;
+}
+
+static bool readInt(const std::string& path, int* value) {
+  std::string content;
+  if (!readFile(path, &content) || content.empty()) {
+    return false;
+  }
+  *value = ::atoi(content.c_str());
+  return true;
+}
+
+// 解析"0-3,8,10-11"格式的CPU列表
+static std::vector<int> parseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  const char* p = list.c_str();
+  while (*p != '\0' && *p != '\n') {
+    char* end = nullptr;
+    long first = ::strtol(p, &end, 10);
+    if (end == p) {
+      break;
+    }
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      last = ::strtol(p + 1, &end, 10);
+      p = end;
+    }
+    for (long cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(static_cast<int>(cpu));
+    }
+    if (*p == ',') {
+      ++p;
+    }
+  }
+  return cpus;
+}
+
+// 当前线程允许运行的CPU
+static std::vector<int> allowedCpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (::sched_getaffinity(0, sizeof(set), &set) < 0) {
+    LOG_ERROR("sched_getaffinity error:%d\n", errno);
+    return cpus;
+  }
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &set)) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+// 每个物理核取一个逻辑CPU，读不到拓扑时把每个逻辑CPU当作一个核
+static std::vector<int> physicalCoreCpus(const std::vector<int>& allowed) {
+  std::vector<int> cpus;
+  std::map<std::pair<int, int>, int> cores;  // (package, core) -> cpu
+  for (int cpu : allowed) {
+    char dir[128];
+    snprintf(dir, sizeof(dir), "/sys/devices/system/cpu/cpu%d/topology/",
+             cpu);
+    int package = 0;
+    int core = cpu;
+    if (!readInt(std::string(dir) + "core_id", &core) ||
+        !readInt(std::string(dir) + "physical_package_id", &package)) {
+      package = 0;
+      core = cpu;
+    }
+    if (cores.insert(std::make_pair(std::make_pair(package, core), cpu))
+            .second) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+// 各NUMA节点上允许运行的CPU，按节点编号排序
+static std::vector<CpuPlacement> numaNodePlacements(
+    const std::vector<int>& allowed) {
+  std::vector<CpuPlacement> nodes;
+  DIR* dir = ::opendir("/sys/devices/system/node");
+  if (dir == nullptr) {
+    return nodes;
+  }
+  while (struct dirent* entry = ::readdir(dir)) {
+    int node = 0;
+    char tail = 0;
+    if (::sscanf(entry->d_name, "node%d%c", &node, &tail) != 1 || node < 0 ||
+        node >= kMaxNumaNodes) {
+      continue;
+    }
+    std::string cpulist;
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+             node);
+    if (!readFile(path, &cpulist)) {
+      continue;
+    }
+    CpuPlacement placement;
+    placement.numaNode = node;
+    for (int cpu : parseCpuList(cpulist)) {
+      if (std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+        placement.cpus.push_back(cpu);
+      }
+    }
+    if (!placement.cpus.empty()) {
+      nodes.push_back(placement);
+    }
+  }
+  ::closedir(dir);
+  std::sort(nodes.begin(), nodes.end(),
+            [](const CpuPlacement& a, const CpuPlacement& b) {
+              return a.numaNode < b.numaNode;
+            });
+  return nodes;
+}
+
+CpuAffinity CpuAffinity::cpuList(const std::vector<int>& cpus) {
+  CpuAffinity affinity(kCpuList);
+  affinity.cpus_ = cpus;
+  return affinity;
+}
+
+CpuAffinity CpuAffinity::physicalCores() { return CpuAffinity(kPhysicalCore); }
+
+CpuAffinity CpuAffinity::numaNodes() { return CpuAffinity(kNumaNode); }
+
+std::vector<CpuPlacement> CpuAffinity::plan(int numThreads) const {
+  std::vector<CpuPlacement> placements(numThreads > 0 ? numThreads : 0);
+  if (policy_ == kNone || placements.empty()) {
+    return placements;
+  }
+
+  if (policy_ == kNumaNode) {
+    std::vector<CpuPlacement> nodes = numaNodePlacements(allowedCpus());
+    if (nodes.empty()) {
+      LOG_WARN("CpuAffinity: no NUMA topology found, loops are not bound\n");
+      return placements;
+    }
+    for (size_t i = 0; i < placements.size(); ++i) {
+      placements[i] = nodes[i % nodes.size()];
+    }
+    return placements;
+  }
+
+  std::vector<int> cpus =
+      policy_ == kCpuList ? cpus_ : physicalCoreCpus(allowedCpus());
+  if (cpus.empty()) {
+    LOG_WARN("CpuAffinity: no usable CPU, loops are not bound\n");
+    return placements;
+  }
+  if (static_cast<size_t>(numThreads) > cpus.size()) {
+    LOG_WARN("CpuAffinity: %d loops share %lu CPUs\n", numThreads,
+             cpus.size());
+  }
+  for (size_t i = 0; i < placements.size(); ++i) {
+    placements[i].cpus.push_back(cpus[i % cpus.size()]);
+  }
+  return placements;
+}
+
+bool CpuAffinity::apply(const CpuPlacement& placement) {
+  bool ok = true;
+  if (!placement.cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : placement.cpus) {
+      if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &set);
+      }
+    }
+    if (::sched_setaffinity(0, sizeof(set), &set) < 0) {
+      LOG_ERROR("sched_setaffinity error:%d\n", errno);
+      ok = false;
+    }
+  }
+  // 之后本线程首次访问的内存优先从该节点分配，EventLoop、Poller以及
+  // 在循环线程中分配或扩容的缓冲区都会落在本地节点上
+  if (placement.numaNode >= 0 && placement.numaNode < kMaxNumaNodes) {
+    unsigned long mask[kMaxNumaNodes / (8 * sizeof(unsigned long))];
+    ::memset(mask, 0, sizeof(mask));
+    mask[placement.numaNode / (8 * sizeof(unsigned long))] |=
+        1UL << (placement.numaNode % (8 * sizeof(unsigned long)));
+    if (::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask,
+                  kMaxNumaNodes + 1) < 0) {
+      LOG_ERROR("set_mempolicy error:%d\n", errno);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+}  // namespace Tnet
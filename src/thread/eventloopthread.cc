@@ -35,6 +35,8 @@ EventLoop *EventLoopThread::startLoop() {
 }
 
 void EventLoopThread::threadFunc() {
+  // 先绑定CPU与内存节点，EventLoop及其Poller的内存就会分配在本地节点上
+  CpuAffinity::apply(placement_);
   EventLoop loop;
 
   if (callback_) {
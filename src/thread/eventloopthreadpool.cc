@@ -1,7 +1,9 @@
 #include "thread/eventloopthreadpool.h"
 
+#include <algorithm>
 #include <memory>
 
+#include "event/eventloop.h"
 #include "thread/eventloopthread.h"
 
 namespace Tnet {
@@ -11,40 +13,130 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop,
       name_(nameArg),
       started_(false),
       numThreads_(0),
-      next_(0) {}
+      next_(0),
+      loadBalance_(kRoundRobin) {}
 
 EventLoopThreadPool::~EventLoopThreadPool() {}
 
 void EventLoopThreadPool::start(const ThreadInitCallback& cb) {
   started_ = true;
 
+  std::vector<CpuPlacement> placements = affinity_.plan(numThreads_);
   for (int i = 0; i < numThreads_; i++) {
     std::vector<char> buf(name_.size() + 32);
     snprintf(buf.data(), buf.size(), "%s%d", name_.c_str(), i);
 
     EventLoopThread* t = new EventLoopThread(cb, buf.data());
+    t->setPlacement(placements[i]);
     threads_.push_back(std::unique_ptr<EventLoopThread>(t));
     loops_.push_back(t->startLoop());
   }
 
+  buildHashRing();
+
   if (numThreads_ == 0 && cb) {
     cb(baseLoop_);
   }
 }
 
-EventLoop* EventLoopThreadPool::getNextLoop() {
-  EventLoop* loop = baseLoop_;
+EventLoop* EventLoopThreadPool::getNextLoop(size_t hashCode) {
+  if (loops_.empty()) {
+    return baseLoop_;
+  }
+  switch (loadBalance_) {
+    case kLeastConnections:
+      return leastConnectionsLoop();
+    case kLeastUtilization:
+      return leastUtilizationLoop();
+    case kConsistentHash:
+      return consistentHashLoop(hashCode);
+    default:
+      return roundRobinLoop();
+  }
+}
 
-  if (!loops_.empty()) {
-    loop = loops_[next_];
-    ++next_;
-    if (static_cast<std::size_t>(next_) >= loops_.size()) {
-      next_ = 0;
-    }
+EventLoop* EventLoopThreadPool::roundRobinLoop() {
+  EventLoop* loop = loops_[next_];
+  ++next_;
+  if (static_cast<std::size_t>(next_) >= loops_.size()) {
+    next_ = 0;
   }
   return loop;
 }
 
+// 从轮询位置开始取第一个连接数最少的loop，轮询位置移到它之后，
+// 负载相同的loop之间仍然轮流分配，不会偏向紧跟在较忙的loop之后的那个
+EventLoop* EventLoopThreadPool::leastConnectionsLoop() {
+  std::size_t size = loops_.size();
+  std::size_t best = static_cast<std::size_t>(next_);
+  int bestCount = loops_[best]->connectionCount();
+  for (std::size_t i = 1; i < size && bestCount > 0; ++i) {
+    std::size_t index = (next_ + i) % size;
+    int count = loops_[index]->connectionCount();
+    if (count < bestCount) {
+      best = index;
+      bestCount = count;
+    }
+  }
+  next_ = static_cast<int>((best + 1) % size);
+  return loops_[best];
+}
+
+// 利用率相差不到kUtilizationSlack视为相同，再按连接数区分，
+// 避免利用率尚未反映出来的一批新连接全部涌向同一个loop
+EventLoop* EventLoopThreadPool::leastUtilizationLoop() {
+  static const double kUtilizationSlack = 0.05;
+  EventLoop* best = roundRobinLoop();
+  double bestUtil = best->utilization();
+  for (std::size_t i = 1; i < loops_.size(); ++i) {
+    EventLoop* loop = loops_[(next_ + i - 1) % loops_.size()];
+    double util = loop->utilization();
+    if (util + kUtilizationSlack < bestUtil ||
+        (util < bestUtil + kUtilizationSlack &&
+         loop->connectionCount() < best->connectionCount())) {
+      best = loop;
+      bestUtil = util;
+    }
+  }
+  return best;
+}
+
+// 64位整数的混合函数（MurmurHash3的fmix64），相近的输入得到分散的输出
+static uint32_t mixHash(uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return static_cast<uint32_t>(key);
+}
+
+EventLoop* EventLoopThreadPool::consistentHashLoop(size_t hashCode) {
+  uint32_t hash = mixHash(hashCode);
+  auto it = std::lower_bound(
+      hashRing_.begin(), hashRing_.end(), hash,
+      [](const std::pair<uint32_t, EventLoop*>& node, uint32_t value) {
+        return node.first < value;
+      });
+  if (it == hashRing_.end()) {
+    it = hashRing_.begin();
+  }
+  return it->second;
+}
+
+// 每个loop在环上放置kVirtualNodes个虚拟节点，增减loop时只有约1/n的来源改变归属
+void EventLoopThreadPool::buildHashRing() {
+  static const int kVirtualNodes = 160;
+  hashRing_.clear();
+  for (std::size_t i = 0; i < loops_.size(); ++i) {
+    for (int v = 0; v < kVirtualNodes; ++v) {
+      uint64_t key = (static_cast<uint64_t>(i) << 32) | v;
+      hashRing_.push_back(std::make_pair(mixHash(~key), loops_[i]));
+    }
+  }
+  std::sort(hashRing_.begin(), hashRing_.end());
+}
+
 std::vector<EventLoop*> EventLoopThreadPool::getAllLoops() {
   if (loops_.empty()) {
     return std::vector<EventLoop*>(1, baseLoop_);
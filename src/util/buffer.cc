@@ -4,8 +4,101 @@
 #include <sys/uio.h>
 #include <unistd.h>
 
+#include "util/bufferpool.h"
+
 namespace Tnet {
 
+char Buffer::emptyStorage_[Buffer::kCheapPrepend];
+
+void Buffer::allocate(std::size_t size) {
+  assert(data_ == nullptr);
+  data_ = BufferPool::allocate(std::max(size, kCheapPrepend + initialSize_),
+                               &capacity_);
+}
+
+void Buffer::release() {
+  if (borrowed_) {
+    borrowed_ = false;
+    data_ = nullptr;
+    capacity_ = 0;
+  } else if (data_ != nullptr) {
+    sizeHint_ = std::max(writerIndex_, kCheapPrepend + initialSize_);
+    BufferPool::deallocate(data_, capacity_);
+    data_ = nullptr;
+    capacity_ = 0;
+  }
+}
+
+// 扩容逻辑，至少翻倍，大消息分多次到达时不会每次都重新分配并拷贝
+void Buffer::makeSpace(std::size_t len) {
+  if (data_ == nullptr) {
+    allocate(std::max(kCheapPrepend + len, sizeHint_));
+    return;
+  }
+  const std::size_t readable = readableBytes();
+  if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
+    // 借用scratch时按以往的用量申请，不跟随scratch的大小翻倍
+    std::size_t capacity = 0;
+    char* data = BufferPool::allocate(
+        std::max(kCheapPrepend + readable + len,
+                 borrowed_ ? sizeHint_ : capacity_ * 2),
+        &capacity);
+    std::copy(begin() + readerIndex_, begin() + writerIndex_,
+              data + kCheapPrepend);
+    if (!borrowed_) {
+      BufferPool::deallocate(data_, capacity_);
+    }
+    borrowed_ = false;
+    data_ = data;
+    capacity_ = capacity;
+  } else {
+    std::copy(begin() + readerIndex_, begin() + writerIndex_,
+              begin() + kCheapPrepend);
+  }
+  readerIndex_ = kCheapPrepend;
+  writerIndex_ = readerIndex_ + readable;
+}
+
+// 借用的scratch属于当前循环，交换之前先归还
+void Buffer::swap(Buffer& rhs) {
+  returnScratch();
+  rhs.returnScratch();
+  std::swap(data_, rhs.data_);
+  std::swap(capacity_, rhs.capacity_);
+  std::swap(readerIndex_, rhs.readerIndex_);
+  std::swap(writerIndex_, rhs.writerIndex_);
+  std::swap(initialSize_, rhs.initialSize_);
+  std::swap(sizeHint_, rhs.sizeHint_);
+}
+
+void Buffer::shrink() {
+  // 借用的scratch不能交给BufferPool，归还时已按可读数据的大小重新申请
+  if (borrowed_) {
+    returnScratch();
+    return;
+  }
+  const std::size_t readable = readableBytes();
+  if (readable == 0) {
+    retrieveAll();
+    return;
+  }
+  std::size_t capacity = 0;
+  char* data = BufferPool::allocate(
+      std::max(kCheapPrepend + readable, kCheapPrepend + initialSize_),
+      &capacity);
+  if (capacity >= capacity_) {
+    BufferPool::deallocate(data, capacity);
+    return;
+  }
+  std::copy(begin() + readerIndex_, begin() + writerIndex_,
+            data + kCheapPrepend);
+  BufferPool::deallocate(data_, capacity_);
+  data_ = data;
+  capacity_ = capacity;
+  readerIndex_ = kCheapPrepend;
+  writerIndex_ = readerIndex_ + readable;
+}
+
 /**
  * 从文件描述符fd读取数据到缓冲区。
  * 使用readv进行高效读取，如果内部缓冲区不足，使用栈上额外空间暂存。
@@ -13,6 +106,9 @@ namespace Tnet {
 ssize_t Buffer::readFd(int fd, int* saveErrno) {
   char extrabuf[65536];  // 额外的栈上空间，用于暂存数据
 
+  if (data_ == nullptr) {
+    allocate(sizeHint_);
+  }
   struct iovec vec[2];
   const std::size_t writable = writableBytes();  // 缓冲区剩余可写空间
 
@@ -29,12 +125,80 @@ ssize_t Buffer::readFd(int fd, int* saveErrno) {
   } else if (static_cast<std::size_t>(n) <= writable) {
     writerIndex_ += n;
   } else {
-    writerIndex_ = buffer_.size();
+    writerIndex_ = capacity_;
     append(extrabuf, n - writable);
   }
+  // 没有读到数据时不占用存储空间
+  if (readableBytes() == 0) {
+    retrieveAll();
+  }
+  return n;
+}
+
+/**
+ * 缓冲区为空时直接读入scratch，数据留在scratch中交给使用者处理，
+ * 只有处理剩下的部分在returnScratch时才拷贝，空闲的连接不需要输入缓冲区。
+ */
+ssize_t Buffer::readFd(int fd, int* saveErrno, char* scratch,
+                       std::size_t size) {
+  assert(!borrowed_);
+  if (readableBytes() > 0) {
+    struct iovec vec[2];
+    const std::size_t writable = writableBytes();
+    vec[0].iov_base = begin() + writerIndex_;
+    vec[0].iov_len = writable;
+    vec[1].iov_base = scratch;
+    vec[1].iov_len = size;
+
+    const ssize_t n = ::readv(fd, vec, 2);
+    if (n < 0) {
+      *saveErrno = errno;
+    } else if (static_cast<std::size_t>(n) <= writable) {
+      writerIndex_ += n;
+    } else {
+      writerIndex_ = capacity_;
+      append(scratch, n - writable);
+    }
+    return n;
+  }
+
+  release();
+  readerIndex_ = writerIndex_ = kCheapPrepend;
+  const ssize_t n =
+      ::read(fd, scratch + kCheapPrepend, size - kCheapPrepend);
+  if (n < 0) {
+    *saveErrno = errno;
+  } else if (n > 0) {
+    data_ = scratch;
+    capacity_ = size;
+    borrowed_ = true;
+    writerIndex_ += n;
+  }
   return n;
 }
 
+void Buffer::returnScratch() {
+  if (!borrowed_) {
+    return;
+  }
+  const std::size_t readable = readableBytes();
+  if (readable == 0) {
+    retrieveAll();
+    return;
+  }
+  std::size_t capacity = 0;
+  char* data = BufferPool::allocate(
+      std::max(kCheapPrepend + readable, kCheapPrepend + initialSize_),
+      &capacity);
+  std::copy(begin() + readerIndex_, begin() + writerIndex_,
+            data + kCheapPrepend);
+  borrowed_ = false;
+  data_ = data;
+  capacity_ = capacity;
+  readerIndex_ = kCheapPrepend;
+  writerIndex_ = readerIndex_ + readable;
+}
+
 /**
  * 将缓冲区数据通过文件描述符fd发送出去。
  */
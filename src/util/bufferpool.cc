@@ -0,0 +1,110 @@
+#include "util/bufferpool.h"
+
+#include <stdlib.h>
+
+#include <new>
+
+namespace Tnet {
+
+const std::size_t BufferPool::kMinBlockSize;
+const std::size_t BufferPool::kMaxBlockSize;
+const std::size_t BufferPool::kMaxCachedBytes;
+const std::size_t BufferPool::kMinCachedBlocks;
+
+// 池析构之后（线程退出时其他thread_local对象的析构中）仍可能有块被释放
+static thread_local bool t_poolDestroyed = false;
+
+// 与原先的std::vector一样，内存不足时抛出std::bad_alloc
+static char* mallocOrThrow(std::size_t size) {
+  void* data = ::malloc(size);
+  if (data == nullptr) {
+    throw std::bad_alloc();
+  }
+  return static_cast<char*>(data);
+}
+
+BufferPool::BufferPool() : cachedBytes_(0) {
+  for (SizeClass& sizeClass : classes_) {
+    sizeClass.head = nullptr;
+    sizeClass.count = 0;
+  }
+}
+
+BufferPool::~BufferPool() {
+  for (SizeClass& sizeClass : classes_) {
+    while (sizeClass.head != nullptr) {
+      FreeBlock* block = sizeClass.head;
+      sizeClass.head = block->next;
+      ::free(block);
+    }
+  }
+  t_poolDestroyed = true;
+}
+
+BufferPool* BufferPool::threadLocal() {
+  if (t_poolDestroyed) {
+    return nullptr;
+  }
+  static thread_local BufferPool pool;
+  return &pool;
+}
+
+int BufferPool::classOf(std::size_t size) {
+  int index = 0;
+  std::size_t blockSize = kMinBlockSize;
+  while (blockSize < size) {
+    blockSize <<= 1;
+    ++index;
+  }
+  return index;
+}
+
+char* BufferPool::allocate(std::size_t size, std::size_t* capacity) {
+  if (size > kMaxBlockSize) {
+    *capacity = size;
+    return mallocOrThrow(size);
+  }
+  int index = classOf(size);
+  *capacity = kMinBlockSize << index;
+
+  BufferPool* pool = threadLocal();
+  if (pool != nullptr) {
+    SizeClass& sizeClass = pool->classes_[index];
+    if (sizeClass.head != nullptr) {
+      FreeBlock* block = sizeClass.head;
+      sizeClass.head = block->next;
+      --sizeClass.count;
+      pool->cachedBytes_ -= *capacity;
+      return reinterpret_cast<char*>(block);
+    }
+  }
+  return mallocOrThrow(*capacity);
+}
+
+void BufferPool::deallocate(char* data, std::size_t capacity) {
+  if (data == nullptr) {
+    return;
+  }
+  BufferPool* pool = threadLocal();
+  if (pool != nullptr && capacity <= kMaxBlockSize) {
+    int index = classOf(capacity);
+    SizeClass& sizeClass = pool->classes_[index];
+    if (sizeClass.count < kMinCachedBlocks ||
+        (sizeClass.count + 1) * capacity <= kMaxCachedBytes) {
+      FreeBlock* block = reinterpret_cast<FreeBlock*>(data);
+      block->next = sizeClass.head;
+      sizeClass.head = block;
+      ++sizeClass.count;
+      pool->cachedBytes_ += capacity;
+      return;
+    }
+  }
+  ::free(data);
+}
+
+std::size_t BufferPool::cachedBytes() {
+  BufferPool* pool = threadLocal();
+  return pool != nullptr ? pool->cachedBytes_ : 0;
+}
+
+}  // namespace Tnet
@@ -0,0 +1,258 @@
+#include "util/chainbuffer.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "tcpserver/endian.h"
+#include "util/bufferpool.h"
+
+namespace Tnet {
+
+const std::size_t ChainBuffer::kBlockSize;
+const std::size_t ChainBuffer::kMinSliceReference;
+
+// writev一次最多使用的块数
+static const int kMaxWriteIov = 64;
+// 末尾块的剩余空间少于此值时，readFd才额外申请一个块接收溢出的数据
+static const std::size_t kMinReadSpace = ChainBuffer::kBlockSize / 4;
+
+ChainBuffer::ChainBuffer() : readable_(0) {}
+
+ChainBuffer::~ChainBuffer() {
+  for (Block& block : blocks_) {
+    freeBlock(&block);
+  }
+}
+
+// 块从当前线程的BufferPool申请，释放后回到池中供其他连接复用
+ChainBuffer::Block ChainBuffer::newBlock(std::size_t capacity) {
+  Block block;
+  block.data = BufferPool::allocate(std::max(capacity, kBlockSize),
+                                    &block.capacity);
+  block.begin = block.end = 0;
+  return block;
+}
+
+void ChainBuffer::freeBlock(Block* block) {
+  if (block->owner) {
+    block->owner.reset();
+  } else {
+    BufferPool::deallocate(block->data, block->capacity);
+  }
+}
+
+void ChainBuffer::popFront() {
+  freeBlock(&blocks_.front());
+  blocks_.pop_front();
+}
+
+const char* ChainBuffer::pullup(std::size_t len) {
+  static const char kEmpty = '\0';
+  assert(len <= readable_);
+  if (blocks_.empty()) {
+    return &kEmpty;
+  }
+  Block& front = blocks_.front();
+  if (front.readable() >= len) {
+    return front.data + front.begin;
+  }
+
+  // 把开头len个字节拷贝到一个足够大的新块中
+  Block merged = newBlock(len);
+  while (merged.end < len) {
+    Block& block = blocks_.front();
+    std::size_t n = std::min(block.readable(), len - merged.end);
+    ::memcpy(merged.data + merged.end, block.data + block.begin, n);
+    merged.end += n;
+    block.begin += n;
+    if (block.readable() == 0) {
+      popFront();
+    }
+  }
+  blocks_.push_front(merged);
+  return merged.data;
+}
+
+void ChainBuffer::retrieve(std::size_t len) {
+  if (len >= readable_) {
+    retrieveAll();
+    return;
+  }
+  readable_ -= len;
+  while (len > 0) {
+    Block& block = blocks_.front();
+    std::size_t n = std::min(block.readable(), len);
+    block.begin += n;
+    len -= n;
+    if (block.readable() == 0) {
+      popFront();
+    }
+  }
+}
+
+void ChainBuffer::retrieveAll() {
+  while (!blocks_.empty()) {
+    popFront();
+  }
+  readable_ = 0;
+}
+
+std::string ChainBuffer::retrieveAsString(std::size_t len) {
+  assert(len <= readable_);
+  std::string result;
+  result.reserve(len);
+  std::size_t left = len;
+  for (const Block& block : blocks_) {
+    if (left == 0) {
+      break;
+    }
+    std::size_t n = std::min(block.readable(), left);
+    result.append(block.data + block.begin, n);
+    left -= n;
+  }
+  retrieve(len);
+  return result;
+}
+
+void ChainBuffer::append(const char* data, std::size_t len) {
+  readable_ += len;
+  if (!blocks_.empty()) {
+    Block& tail = blocks_.back();
+    std::size_t n = std::min(tail.writable(), len);
+    ::memcpy(tail.data + tail.end, data, n);
+    tail.end += n;
+    data += n;
+    len -= n;
+  }
+  while (len > 0) {
+    Block block = newBlock(kBlockSize);
+    std::size_t n = std::min(block.capacity, len);
+    ::memcpy(block.data, data, n);
+    block.end = n;
+    blocks_.push_back(block);
+    data += n;
+    len -= n;
+  }
+}
+
+void ChainBuffer::append(const Slice& slice) {
+  if (slice.size() < kMinSliceReference) {
+    append(slice.data(), slice.size());
+    return;
+  }
+  Block block;
+  block.data = const_cast<char*>(slice.data());  // 只读，不会写入
+  block.capacity = slice.size();
+  block.begin = 0;
+  block.end = slice.size();
+  block.owner = slice.storage_;
+  blocks_.push_back(std::move(block));
+  readable_ += slice.size();
+}
+
+void ChainBuffer::appendInt32(int32_t x) {
+  int32_t be32 = Endian::hostToNetwork32(x);
+  append(&be32, sizeof(be32));
+}
+
+int32_t ChainBuffer::peekInt32() {
+  assert(readable_ >= sizeof(int32_t));
+  int32_t be32 = 0;
+  ::memcpy(&be32, pullup(sizeof(int32_t)), sizeof(int32_t));
+  return Endian::networkToHost32(be32);
+}
+
+/**
+ * 从文件描述符fd读取数据到缓冲区。
+ * 先填充末尾块的剩余空间，剩余空间较少时再加上一个新块，
+ * 仍然不够时用栈上空间暂存，溢出的部分追加为新块，已有数据不会被搬移。
+ * 大多数读取都落在末尾块中，不需要为可能用不到的新块访问BufferPool。
+ */
+ssize_t ChainBuffer::readFd(int fd, int* saveErrno) {
+  char extrabuf[65536];
+  struct iovec vec[3];
+  int iovcnt = 0;
+
+  if (blocks_.empty() || blocks_.back().writable() == 0) {
+    blocks_.push_back(newBlock(kBlockSize));
+  }
+  Block& tail = blocks_.back();
+  vec[iovcnt].iov_base = tail.data + tail.end;
+  vec[iovcnt].iov_len = tail.writable();
+  ++iovcnt;
+
+  Block next = Block();
+  if (tail.writable() < kMinReadSpace) {
+    next = newBlock(kBlockSize);
+    vec[iovcnt].iov_base = next.data;
+    vec[iovcnt].iov_len = next.capacity;
+    ++iovcnt;
+  }
+
+  vec[iovcnt].iov_base = extrabuf;
+  vec[iovcnt].iov_len = sizeof(extrabuf);
+  ++iovcnt;
+
+  const ssize_t n = ::readv(fd, vec, iovcnt);
+  std::size_t left = n > 0 ? static_cast<std::size_t>(n) : 0;
+  if (n < 0) {
+    *saveErrno = errno;
+  }
+
+  std::size_t used = std::min(left, tail.writable());
+  tail.end += used;
+  readable_ += used;
+  left -= used;
+
+  if (next.data != nullptr) {
+    used = std::min(left, next.capacity);
+    if (used > 0) {
+      next.end = used;
+      blocks_.push_back(next);
+      readable_ += used;
+      left -= used;
+    } else {
+      freeBlock(&next);
+    }
+  }
+
+  if (left > 0) {
+    append(extrabuf, left);
+  }
+  // 读到0字节时不保留刚补上的空块
+  if (blocks_.back().readable() == 0) {
+    freeBlock(&blocks_.back());
+    blocks_.pop_back();
+  }
+  return n;
+}
+
+/**
+ * 将缓冲区数据通过文件描述符fd发送出去，一次writev覆盖多个块。
+ */
+ssize_t ChainBuffer::writeFd(int fd, int* saveErrno, std::size_t maxBytes) {
+  struct iovec vec[kMaxWriteIov];
+  int iovcnt = 0;
+  for (const Block& block : blocks_) {
+    if (iovcnt == kMaxWriteIov || maxBytes == 0) {
+      break;
+    }
+    vec[iovcnt].iov_base = block.data + block.begin;
+    vec[iovcnt].iov_len = std::min(block.readable(), maxBytes);
+    maxBytes -= vec[iovcnt].iov_len;
+    ++iovcnt;
+  }
+
+  ssize_t n = ::writev(fd, vec, iovcnt);
+  if (n < 0) {
+    *saveErrno = errno;
+  }
+  return n;
+}
+
+}  // namespace Tnet
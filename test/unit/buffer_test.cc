@@ -0,0 +1,132 @@
+#include "util/buffer.h"
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+#include "util/bufferpool.h"
+
+using namespace Tnet;
+
+namespace {
+
+const std::size_t kScratchSize = 256 * 1024;
+
+class BufferScratchTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds_));
+    scratch_.reset(new char[kScratchSize]);
+  }
+  void TearDown() override {
+    ::close(fds_[0]);
+    ::close(fds_[1]);
+  }
+
+  void peerWrite(const std::string& data) {
+    ASSERT_EQ(static_cast<ssize_t>(data.size()),
+              ::write(fds_[1], data.data(), data.size()));
+  }
+
+  bool inScratch(const char* p) const {
+    return p >= scratch_.get() && p < scratch_.get() + kScratchSize;
+  }
+
+  // 模拟循环线程在下一次读取时复用scratch
+  void clobberScratch() { ::memset(scratch_.get(), '#', kScratchSize); }
+
+  int fds_[2];
+  std::unique_ptr<char[]> scratch_;
+};
+
+}  // namespace
+
+// 空缓冲区直接读入scratch并借作存储空间，归还时只拷贝未处理的部分
+TEST_F(BufferScratchTest, BorrowWhenEmpty) {
+  Buffer buf;
+  peerWrite("hello world");
+  int err = 0;
+  ASSERT_EQ(11, buf.readFd(fds_[0], &err, scratch_.get(), kScratchSize));
+  EXPECT_TRUE(inScratch(buf.peek()));
+
+  buf.retrieve(6);
+  buf.returnScratch();
+  EXPECT_FALSE(inScratch(buf.peek()));
+  clobberScratch();
+  EXPECT_EQ("world", buf.retrieveAllAsString());
+}
+
+// 全部处理完时归还scratch不需要申请存储空间
+TEST_F(BufferScratchTest, ReturnEmptyScratch) {
+  Buffer buf;
+  peerWrite("ping");
+  int err = 0;
+  ASSERT_EQ(4, buf.readFd(fds_[0], &err, scratch_.get(), kScratchSize));
+  EXPECT_EQ("ping", buf.retrieveAllAsString());
+  buf.returnScratch();
+  EXPECT_EQ(0u, buf.internalCapacity());
+}
+
+// 缓冲区非空时scratch只用来暂存溢出的数据
+TEST_F(BufferScratchTest, OverflowIntoOwnStorage) {
+  Buffer buf;
+  buf.append("head:", 5);
+  std::string body(100000, 'b');
+  peerWrite(body);
+  int err = 0;
+  ssize_t n = buf.readFd(fds_[0], &err, scratch_.get(), kScratchSize);
+  ASSERT_EQ(static_cast<ssize_t>(body.size()), n);
+  EXPECT_FALSE(inScratch(buf.peek()));
+  clobberScratch();
+  EXPECT_EQ("head:" + body, buf.retrieveAllAsString());
+}
+
+// 借用期间追加数据会换到自己的存储空间
+TEST_F(BufferScratchTest, AppendWhileBorrowed) {
+  Buffer buf;
+  peerWrite("abc");
+  int err = 0;
+  ASSERT_EQ(3, buf.readFd(fds_[0], &err, scratch_.get(), kScratchSize));
+  std::string tail(kScratchSize, 't');
+  buf.append(tail.data(), tail.size());
+  EXPECT_FALSE(inScratch(buf.peek()));
+  buf.returnScratch();
+  clobberScratch();
+  EXPECT_EQ("abc" + tail, buf.retrieveAllAsString());
+}
+
+// 回调中对借用scratch的缓冲区调用shrink，scratch不能交给BufferPool
+TEST_F(BufferScratchTest, ShrinkWhileBorrowed) {
+  Buffer buf;
+  peerWrite("partial message");
+  int err = 0;
+  ASSERT_EQ(15, buf.readFd(fds_[0], &err, scratch_.get(), kScratchSize));
+  buf.retrieve(8);
+  buf.shrink();
+  EXPECT_FALSE(inScratch(buf.peek()));
+  clobberScratch();
+  EXPECT_EQ("message", buf.retrieveAllAsString());
+
+  // scratch没有进入池中，之后同级的分配不会拿到它
+  std::size_t capacity = 0;
+  char* data = BufferPool::allocate(kScratchSize, &capacity);
+  EXPECT_FALSE(inScratch(data));
+  BufferPool::deallocate(data, capacity);
+}
+
+// 移动借用scratch的缓冲区时先归还，接收方拥有独立的存储空间
+TEST_F(BufferScratchTest, MoveWhileBorrowed) {
+  Buffer buf;
+  peerWrite("moved");
+  int err = 0;
+  ASSERT_EQ(5, buf.readFd(fds_[0], &err, scratch_.get(), kScratchSize));
+  Buffer other(std::move(buf));
+  EXPECT_EQ(0u, buf.readableBytes());
+  EXPECT_FALSE(inScratch(other.peek()));
+  clobberScratch();
+  EXPECT_EQ("moved", other.retrieveAllAsString());
+}
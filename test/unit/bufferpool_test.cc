@@ -0,0 +1,139 @@
+#include "util/bufferpool.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "util/buffer.h"
+
+using namespace Tnet;
+
+// 分配大小向上取到2的幂，最小kMinBlockSize
+TEST(BufferPoolTest, SizeClasses) {
+  std::size_t capacity = 0;
+  char* data = BufferPool::allocate(1, &capacity);
+  EXPECT_EQ(BufferPool::kMinBlockSize, capacity);
+  BufferPool::deallocate(data, capacity);
+
+  data = BufferPool::allocate(5000, &capacity);
+  EXPECT_EQ(8192u, capacity);
+  BufferPool::deallocate(data, capacity);
+
+  // 超过kMaxBlockSize的请求直接向系统申请，按原大小返回，也不进入缓存
+  std::size_t cached = BufferPool::cachedBytes();
+  data = BufferPool::allocate(BufferPool::kMaxBlockSize + 1, &capacity);
+  EXPECT_EQ(BufferPool::kMaxBlockSize + 1, capacity);
+  BufferPool::deallocate(data, capacity);
+  EXPECT_EQ(cached, BufferPool::cachedBytes());
+}
+
+// 释放的块被同一线程的下一次同级分配复用
+TEST(BufferPoolTest, ReusesFreedBlocks) {
+  std::size_t capacity = 0;
+  char* first = BufferPool::allocate(4096, &capacity);
+  BufferPool::deallocate(first, capacity);
+  std::size_t cached = BufferPool::cachedBytes();
+  EXPECT_GE(cached, capacity);
+
+  std::size_t again = 0;
+  char* second = BufferPool::allocate(3000, &again);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(capacity, again);
+  EXPECT_EQ(cached - capacity, BufferPool::cachedBytes());
+  BufferPool::deallocate(second, again);
+}
+
+// 每一级缓存的字节数不超过kMaxCachedBytes
+TEST(BufferPoolTest, CachePerClassIsBounded) {
+  const std::size_t kSize = 64 * 1024;
+  std::vector<char*> blocks;
+  std::size_t capacity = 0;
+  for (int i = 0; i < 32; ++i) {
+    blocks.push_back(BufferPool::allocate(kSize, &capacity));
+  }
+  std::size_t before = BufferPool::cachedBytes();
+  for (char* block : blocks) {
+    BufferPool::deallocate(block, capacity);
+  }
+  EXPECT_LE(BufferPool::cachedBytes() - before, BufferPool::kMaxCachedBytes);
+}
+
+// 超过kMaxCachedBytes的大块每一级也能缓存kMinCachedBlocks个
+TEST(BufferPoolTest, ReusesLargestBlocks) {
+  std::size_t capacity = 0;
+  char* first = BufferPool::allocate(BufferPool::kMaxBlockSize, &capacity);
+  char* second = BufferPool::allocate(BufferPool::kMaxBlockSize, &capacity);
+  char* third = BufferPool::allocate(BufferPool::kMaxBlockSize, &capacity);
+  EXPECT_EQ(BufferPool::kMaxBlockSize, capacity);
+  std::size_t before = BufferPool::cachedBytes();
+  BufferPool::deallocate(first, capacity);
+  BufferPool::deallocate(second, capacity);
+  BufferPool::deallocate(third, capacity);
+  EXPECT_EQ(before + BufferPool::kMinCachedBlocks * capacity,
+            BufferPool::cachedBytes());
+
+  std::size_t again = 0;
+  char* reused = BufferPool::allocate(BufferPool::kMaxBlockSize, &again);
+  EXPECT_EQ(second, reused);
+  BufferPool::deallocate(reused, again);
+}
+
+// 每个线程有自己的池，其他线程缓存的块不可见
+TEST(BufferPoolTest, ThreadLocal) {
+  std::size_t capacity = 0;
+  char* data = BufferPool::allocate(2048, &capacity);
+  BufferPool::deallocate(data, capacity);
+  std::size_t cached = BufferPool::cachedBytes();
+  ASSERT_GT(cached, 0u);
+
+  std::size_t otherCached = cached;
+  std::thread([&] { otherCached = BufferPool::cachedBytes(); }).join();
+  EXPECT_EQ(0u, otherCached);
+  EXPECT_EQ(cached, BufferPool::cachedBytes());
+}
+
+// Buffer在第一次写入时才申请存储空间，读空后归还
+TEST(BufferTest, LazyStorage) {
+  Buffer buf;
+  EXPECT_EQ(0u, buf.internalCapacity());
+  EXPECT_EQ(0u, buf.writableBytes());
+  EXPECT_EQ(0u, buf.readableBytes());
+
+  buf.append("hello", 5);
+  EXPECT_GT(buf.internalCapacity(), 0u);
+  EXPECT_EQ("hel", buf.retrieveAsString(3));
+  EXPECT_GT(buf.internalCapacity(), 0u);
+  EXPECT_EQ("lo", buf.retrieveAllAsString());
+  EXPECT_EQ(0u, buf.internalCapacity());
+}
+
+// 扩容后数据不变，收缩到刚好容纳可读数据
+TEST(BufferTest, GrowAndShrink) {
+  Buffer buf;
+  std::string data(200000, 'x');
+  for (std::size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<char>('a' + i % 26);
+  }
+  for (std::size_t off = 0; off < data.size(); off += 1000) {
+    buf.append(data.data() + off, 1000);
+  }
+  EXPECT_GE(buf.internalCapacity(), data.size());
+  EXPECT_EQ(data, std::string(buf.peek(), buf.readableBytes()));
+
+  buf.retrieve(199000);
+  std::size_t before = buf.internalCapacity();
+  buf.shrink();
+  EXPECT_LT(buf.internalCapacity(), before);
+  EXPECT_EQ(data.substr(199000), buf.retrieveAllAsString());
+}
+
+TEST(BufferTest, PrependAndInt32) {
+  Buffer buf;
+  buf.appendInt32(42);
+  int32_t len = 4;
+  buf.prepend(&len, sizeof(len));
+  EXPECT_EQ(8u, buf.readableBytes());
+  buf.retrieve(sizeof(len));
+  EXPECT_EQ(42, buf.peekInt32());
+}
@@ -0,0 +1,135 @@
+#include "util/chainbuffer.h"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <random>
+#include <string>
+
+using namespace Tnet;
+
+namespace {
+
+std::string randomBytes(std::mt19937* rng, std::size_t len) {
+  std::string s(len, '\0');
+  for (char& c : s) {
+    c = static_cast<char>((*rng)());
+  }
+  return s;
+}
+
+}  // namespace
+
+TEST(ChainBufferTest, AppendRetrieveAcrossBlocks) {
+  ChainBuffer buf;
+  std::string data(3 * ChainBuffer::kBlockSize + 123, 'a');
+  for (std::size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<char>('a' + i % 26);
+  }
+  buf.append(data.data(), data.size());
+  EXPECT_EQ(data.size(), buf.readableBytes());
+
+  buf.retrieve(ChainBuffer::kBlockSize + 7);
+  EXPECT_EQ(data.substr(ChainBuffer::kBlockSize + 7),
+            std::string(buf.peek(), buf.readableBytes()));
+  EXPECT_EQ(data.substr(ChainBuffer::kBlockSize + 7, 10),
+            buf.retrieveAsString(10));
+  buf.retrieveAll();
+  EXPECT_EQ(0u, buf.readableBytes());
+}
+
+// pullup跨块时合并到一个块中，返回的连续视图与原数据一致
+TEST(ChainBufferTest, PullupMergesBlocks) {
+  ChainBuffer buf;
+  std::string first(ChainBuffer::kBlockSize - 2, 'x');
+  buf.append(first.data(), first.size());
+  buf.appendInt32(0x01020304);
+  EXPECT_EQ(first.size() + 4, buf.readableBytes());
+
+  buf.retrieve(first.size());
+  EXPECT_EQ(0x01020304, buf.peekInt32());  // 4个字节跨越两个块
+  const char* merged = buf.pullup(4);
+  EXPECT_EQ(merged, buf.pullup(4));  // 合并后不再拷贝
+}
+
+// 随机的追加、取出、合并操作与std::string模型保持一致
+TEST(ChainBufferTest, MatchesStringModel) {
+  std::mt19937 rng(1);
+  ChainBuffer buf;
+  std::string model;
+  for (int i = 0; i < 5000; ++i) {
+    int op = rng() % 5;
+    if (op <= 1) {
+      std::string s = randomBytes(&rng, rng() % (op ? 40000 : 100));
+      buf.append(s.data(), s.size());
+      model += s;
+    } else if (!model.empty()) {
+      std::size_t n = rng() % (model.size() + 1);
+      if (op == 2) {
+        buf.retrieve(n);
+      } else if (op == 3) {
+        ASSERT_EQ(model.substr(0, n), std::string(buf.pullup(n), n));
+        continue;
+      } else {
+        ASSERT_EQ(model.substr(0, n), buf.retrieveAsString(n));
+      }
+      model.erase(0, n);
+    }
+    ASSERT_EQ(model.size(), buf.readableBytes());
+  }
+  EXPECT_EQ(model, std::string(buf.peek(), buf.readableBytes()));
+}
+
+// readFd/writeFd通过readv/writev收发，数据完整且顺序不变
+TEST(ChainBufferTest, ReadWriteFd) {
+  int sv[2];
+  ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv));
+  std::mt19937 rng(2);
+  std::string payload = randomBytes(&rng, 1000000);
+
+  ChainBuffer out;
+  ChainBuffer in;
+  out.append(payload.data(), payload.size());
+  int err = 0;
+  while (out.readableBytes() > 0 || in.readableBytes() < payload.size()) {
+    if (out.readableBytes() > 0) {
+      ssize_t n = out.writeFd(sv[0], &err, 100000);  // 限制单次发送的字节数
+      ASSERT_TRUE(n > 0 || err == EAGAIN);
+      ASSERT_LE(n, 100000);
+      if (n > 0) {
+        out.retrieve(n);
+      }
+    }
+    ssize_t n = in.readFd(sv[1], &err);
+    ASSERT_TRUE(n > 0 || err == EAGAIN);
+  }
+  EXPECT_EQ(payload, in.retrieveAllAsString());
+  ::close(sv[0]);
+  ::close(sv[1]);
+}
+
+// 末尾块剩余空间多少不同时，readFd分别经过新块或栈上空间接收溢出的数据
+TEST(ChainBufferTest, ReadFdSpillsPastTailBlock) {
+  std::mt19937 rng(3);
+  const std::size_t prefixes[] = {0, 1000, ChainBuffer::kBlockSize - 1000};
+  for (std::size_t prefix : prefixes) {
+    int sv[2];
+    ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv));
+    std::string head = randomBytes(&rng, prefix);
+    std::string payload = randomBytes(&rng, 40000);
+    ASSERT_EQ(static_cast<ssize_t>(payload.size()),
+              ::write(sv[0], payload.data(), payload.size()));
+
+    ChainBuffer in;
+    in.append(head.data(), head.size());
+    int err = 0;
+    while (in.readableBytes() < prefix + payload.size()) {
+      ASSERT_GT(in.readFd(sv[1], &err), 0);
+    }
+    EXPECT_EQ(head + payload, in.retrieveAllAsString()) << "prefix " << prefix;
+    ::close(sv[0]);
+    ::close(sv[1]);
+  }
+}
@@ -0,0 +1,52 @@
+#include "tcpserver/connector.h"
+
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include "event/eventloop.h"
+#include "tcpserver/inetaddress.h"
+#include "util/timestamp.h"
+
+using namespace Tnet;
+
+// 连接被拒绝后按500ms、1s、2s……的间隔重试，等待期间循环照常运行。
+// 端口在0.7秒后才开始监听：第二次重试（1.5秒）才能连上
+TEST(ConnectorTest, RetryBacksOff) {
+  EventLoop loop;
+
+  // 绑定但不监听的socket占住端口，连接会被拒绝
+  int listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  ASSERT_GE(listenFd, 0);
+  InetAddress any(0);
+  ASSERT_EQ(0, ::bind(listenFd, (const sockaddr*)any.getSockAddr(),
+                      sizeof(sockaddr_in)));
+  sockaddr_in local;
+  socklen_t len = sizeof(local);
+  ASSERT_EQ(0, ::getsockname(listenFd, (sockaddr*)&local, &len));
+
+  Timestamp start(Timestamp::now());
+  double connectedAt = -1.0;
+  int ticks = 0;
+  std::shared_ptr<Connector> connector =
+      std::make_shared<Connector>(&loop, InetAddress(local));
+  connector->setNewConnectionCallback([&](int sockfd) {
+    connectedAt = timeDifference(Timestamp::now(), start);
+    ::close(sockfd);
+    loop.quit();
+  });
+  connector->start();
+
+  loop.runAfter(0.7, [&] { ASSERT_EQ(0, ::listen(listenFd, 16)); });
+  loop.runEvery(0.1, [&] { ++ticks; });  // 重试期间循环没有被阻塞
+  loop.runAfter(5.0, [&] { loop.quit(); });  // 兜底
+  loop.loop();
+
+  EXPECT_GE(connectedAt, 1.5);
+  EXPECT_LT(connectedAt, 3.0);
+  EXPECT_GE(ticks, 10);
+  ::close(listenFd);
+}
@@ -0,0 +1,198 @@
+#include "thread/cpuaffinity.h"
+
+#include <gtest/gtest.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "event/eventloop.h"
+#include "thread/eventloopthreadpool.h"
+
+using namespace Tnet;
+
+namespace {
+
+// 当前线程允许运行的CPU
+std::vector<int> currentCpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  return cpus;
+}
+
+// 当前线程的内存策略偏好的NUMA节点，没有设置MPOL_PREFERRED时返回-1
+int preferredNode() {
+  const int kMaxNodes = 1024;
+  int mode = -1;
+  unsigned long mask[kMaxNodes / (8 * sizeof(unsigned long))] = {0};
+  if (::syscall(SYS_get_mempolicy, &mode, mask, kMaxNodes, nullptr, 0) < 0 ||
+      mode != MPOL_PREFERRED) {
+    return -1;
+  }
+  for (int node = 0; node < kMaxNodes; ++node) {
+    if (mask[node / (8 * sizeof(unsigned long))] &
+        (1UL << (node % (8 * sizeof(unsigned long))))) {
+      return node;
+    }
+  }
+  return -1;
+}
+
+// CPU所在的(package, core)，读不到拓扑时把每个逻辑CPU当作一个核
+std::pair<int, int> coreOf(int cpu) {
+  char dir[128];
+  snprintf(dir, sizeof(dir), "/sys/devices/system/cpu/cpu%d/topology/", cpu);
+  int package = -1;
+  int core = -1;
+  FILE* fp = ::fopen((std::string(dir) + "physical_package_id").c_str(), "r");
+  if (fp != nullptr) {
+    if (::fscanf(fp, "%d", &package) != 1) {
+      package = -1;
+    }
+    ::fclose(fp);
+  }
+  fp = ::fopen((std::string(dir) + "core_id").c_str(), "r");
+  if (fp != nullptr) {
+    if (::fscanf(fp, "%d", &core) != 1) {
+      core = -1;
+    }
+    ::fclose(fp);
+  }
+  if (package < 0 || core < 0) {
+    return std::make_pair(0, cpu);
+  }
+  return std::make_pair(package, core);
+}
+
+// 依次记录每个loop线程启动时的CPU集合与内存节点。
+// 线程池逐个启动线程，记录顺序就是loop的下标
+struct PlacementRecorder {
+  void operator()(EventLoop*) {
+    std::lock_guard<std::mutex> lock(mutex);
+    cpus.push_back(currentCpus());
+    nodes.push_back(preferredNode());
+  }
+
+  std::mutex mutex;
+  std::vector<std::vector<int>> cpus;
+  std::vector<int> nodes;
+};
+
+}  // namespace
+
+// 第i个loop绑定到列表中的第i个CPU，不够时循环使用；kNone不绑定
+TEST(CpuAffinityTest, CpuListPlanCycles) {
+  std::vector<CpuPlacement> none = CpuAffinity().plan(3);
+  ASSERT_EQ(3u, none.size());
+  for (const CpuPlacement& placement : none) {
+    EXPECT_TRUE(placement.cpus.empty());
+    EXPECT_EQ(-1, placement.numaNode);
+  }
+
+  std::vector<CpuPlacement> plan = CpuAffinity::cpuList({3, 5}).plan(5);
+  ASSERT_EQ(5u, plan.size());
+  const int expected[] = {3, 5, 3, 5, 3};
+  for (size_t i = 0; i < plan.size(); ++i) {
+    EXPECT_EQ(std::vector<int>(1, expected[i]), plan[i].cpus);
+    EXPECT_EQ(-1, plan[i].numaNode);
+  }
+}
+
+// 每个loop分到一个允许运行的CPU，物理核用完之前不与其他loop共享一个核
+// （超线程兄弟算同一个核），之后循环使用
+TEST(CpuAffinityTest, PhysicalCorePlanAvoidsSiblings) {
+  std::vector<int> allowed = currentCpus();
+  ASSERT_FALSE(allowed.empty());
+  std::set<std::pair<int, int>> cores;
+  for (int cpu : allowed) {
+    cores.insert(coreOf(cpu));
+  }
+
+  int numThreads = static_cast<int>(cores.size()) + 1;
+  std::vector<CpuPlacement> plan =
+      CpuAffinity::physicalCores().plan(numThreads);
+  ASSERT_EQ(static_cast<size_t>(numThreads), plan.size());
+  std::set<std::pair<int, int>> used;
+  for (size_t i = 0; i < cores.size(); ++i) {
+    ASSERT_EQ(1u, plan[i].cpus.size());
+    int cpu = plan[i].cpus[0];
+    EXPECT_TRUE(std::find(allowed.begin(), allowed.end(), cpu) !=
+                allowed.end());
+    EXPECT_TRUE(used.insert(coreOf(cpu)).second) << "cpu " << cpu;
+    EXPECT_EQ(-1, plan[i].numaNode);
+  }
+  EXPECT_EQ(plan[0].cpus, plan[cores.size()].cpus);
+}
+
+// loop线程在创建EventLoop之前就已经绑定到计划的CPU上
+TEST(CpuAffinityTest, LoopThreadsArePinned) {
+  std::vector<int> allowed = currentCpus();
+  ASSERT_FALSE(allowed.empty());
+  std::vector<int> list = {allowed.back(), allowed.front()};
+
+  EventLoop baseLoop;
+  PlacementRecorder recorder;
+  {
+    EventLoopThreadPool pool(&baseLoop, "pinned");
+    pool.setThreadNum(3);
+    pool.setAffinity(CpuAffinity::cpuList(list));
+    pool.start(std::ref(recorder));
+  }
+
+  ASSERT_EQ(3u, recorder.cpus.size());
+  for (size_t i = 0; i < recorder.cpus.size(); ++i) {
+    EXPECT_EQ(std::vector<int>(1, list[i % list.size()]), recorder.cpus[i]);
+    EXPECT_EQ(-1, recorder.nodes[i]);
+  }
+  EXPECT_EQ(allowed, currentCpus());  // 调用线程不受影响
+}
+
+// 按NUMA节点分布时，loop线程绑定到节点内允许的CPU，并优先从该节点分配内存
+TEST(CpuAffinityTest, NumaNodePlacement) {
+  std::vector<int> allowed = currentCpus();
+  std::vector<CpuPlacement> plan = CpuAffinity::numaNodes().plan(2);
+  ASSERT_EQ(2u, plan.size());
+  if (plan[0].numaNode < 0) {
+    GTEST_SKIP() << "no NUMA topology";
+  }
+  for (const CpuPlacement& placement : plan) {
+    ASSERT_FALSE(placement.cpus.empty());
+    for (int cpu : placement.cpus) {
+      EXPECT_TRUE(std::find(allowed.begin(), allowed.end(), cpu) !=
+                  allowed.end());
+    }
+  }
+
+  EventLoop baseLoop;
+  PlacementRecorder recorder;
+  {
+    EventLoopThreadPool pool(&baseLoop, "numa");
+    pool.setThreadNum(2);
+    pool.setAffinity(CpuAffinity::numaNodes());
+    pool.start(std::ref(recorder));
+  }
+
+  ASSERT_EQ(2u, recorder.cpus.size());
+  for (size_t i = 0; i < plan.size(); ++i) {
+    EXPECT_EQ(plan[i].cpus, recorder.cpus[i]);
+    EXPECT_EQ(plan[i].numaNode, recorder.nodes[i]);
+  }
+  EXPECT_EQ(-1, preferredNode());
+}
@@ -0,0 +1,158 @@
+#include "event/epoller.h"
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+#include "event/channel.h"
+#include "event/eventloop.h"
+
+using namespace Tnet;
+
+namespace {
+
+// 统计对t_watchedFd的epoll_ctl调用次数
+thread_local int t_watchedFd = -1;
+thread_local int t_epollCtlCount = 0;
+
+}  // namespace
+
+extern "C" int epoll_ctl(int epfd, int op, int fd, struct epoll_event* event) {
+  if (fd == t_watchedFd) {
+    ++t_epollCtlCount;
+  }
+  return static_cast<int>(::syscall(SYS_epoll_ctl, epfd, op, fd, event));
+}
+
+namespace {
+
+// 非阻塞管道，读端挂在channel上，读到的数据追加到received
+struct PipeReader {
+  PipeReader(EventLoop* loop, int minFd) {
+    int fds[2];
+    if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+      readFd = writeFd = -1;
+      return;
+    }
+    // 把读端移到minFd及以上，用于测试较大的fd
+    readFd = ::fcntl(fds[0], F_DUPFD_CLOEXEC, minFd);
+    ::close(fds[0]);
+    writeFd = fds[1];
+    channel.reset(new Channel(loop, readFd));
+    channel->setReadCallback([this](Timestamp) {
+      char buf[64];
+      ssize_t n = ::read(readFd, buf, sizeof(buf));
+      if (n > 0) {
+        received.append(buf, n);
+      }
+    });
+  }
+  ~PipeReader() {
+    if (channel) {
+      channel->disableAll();
+      channel->remove();
+    }
+    ::close(readFd);
+    ::close(writeFd);
+  }
+
+  int readFd;
+  int writeFd;
+  std::unique_ptr<Channel> channel;
+  std::string received;
+};
+
+}  // namespace
+
+// 以fd为下标的channel表按需扩容；移除后同一fd号可以注册新的channel
+TEST(EpollerTest, ChannelTableHandlesLargeAndReusedFds) {
+  EventLoop loop;
+  std::unique_ptr<PipeReader> first(new PipeReader(&loop, 900));
+  ASSERT_GE(first->readFd, 900);
+  first->channel->enableReading();
+  EXPECT_TRUE(loop.hasChannel(first->channel.get()));
+
+  int fd = first->readFd;
+  std::unique_ptr<PipeReader> second;
+  loop.runAfter(0.01, [&] {
+    ASSERT_EQ(2, ::write(first->writeFd, "ab", 2));
+  });
+  loop.runAfter(0.05, [&] {
+    Channel* old = first->channel.get();
+    first->channel->disableAll();
+    first->channel->remove();
+    EXPECT_FALSE(loop.hasChannel(old));
+    ::close(first->readFd);
+    first->channel.reset();
+    first->readFd = -1;
+
+    second.reset(new PipeReader(&loop, fd));
+    ASSERT_EQ(fd, second->readFd);
+    second->channel->enableReading();
+    EXPECT_TRUE(loop.hasChannel(second->channel.get()));
+    ASSERT_EQ(2, ::write(second->writeFd, "cd", 2));
+  });
+  loop.runAfter(0.1, [&] { loop.quit(); });
+  loop.loop();
+
+  EXPECT_EQ("ab", first->received);
+  ASSERT_TRUE(second);
+  EXPECT_EQ("cd", second->received);
+}
+
+// 一轮循环中对同一channel的多次修改在下一次epoll_wait前合并提交
+TEST(EpollerTest, UpdatesAreCoalescedPerIteration) {
+  EventLoop loop;
+  PipeReader reader(&loop, 0);
+  ASSERT_GE(reader.readFd, 0);
+  PipeReader transient(&loop, 0);
+  ASSERT_GE(transient.readFd, 0);
+  Channel* channel = reader.channel.get();
+  int addCount = -1;
+  int toggleCount = -1;
+  int transientCount = -1;
+
+  // 添加后又修改两次：只有一次EPOLL_CTL_ADD
+  loop.queueInLoop([&] {
+    t_watchedFd = reader.readFd;
+    t_epollCtlCount = 0;
+    channel->enableReading();
+    channel->enableWriting();
+    channel->disableWriting();
+  });
+  loop.runAfter(0.01, [&] {
+    addCount = t_epollCtlCount;
+    // 修改后又改回原样：不需要epoll_ctl
+    t_epollCtlCount = 0;
+    channel->enableWriting();
+    channel->disableWriting();
+  });
+  loop.runAfter(0.02, [&] {
+    toggleCount = t_epollCtlCount;
+    // 添加、修改后立即移除：内核从未见过这个fd
+    t_watchedFd = transient.readFd;
+    t_epollCtlCount = 0;
+    transient.channel->enableReading();
+    transient.channel->enableWriting();
+    transient.channel->disableAll();
+    transient.channel->remove();
+    transient.channel.reset();
+  });
+  loop.runAfter(0.03, [&] {
+    transientCount = t_epollCtlCount;
+    ASSERT_EQ(1, ::write(reader.writeFd, "x", 1));
+  });
+  loop.runAfter(0.05, [&] { loop.quit(); });
+  loop.loop();
+  t_watchedFd = -1;
+
+  EXPECT_EQ(1, addCount);
+  EXPECT_EQ(0, toggleCount);
+  EXPECT_LE(transientCount, 1);
+  EXPECT_EQ("x", reader.received);  // 合并后的注册仍然生效
+}
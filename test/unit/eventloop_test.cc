@@ -0,0 +1,229 @@
+#include "event/eventloop.h"
+
+#include <gtest/gtest.h>
+#include <time.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "thread/eventloopthread.h"
+
+using namespace Tnet;
+
+namespace {
+
+// 统计当前线程的堆分配次数
+thread_local int t_allocations = 0;
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  ++t_allocations;
+  void* p = std::malloc(size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// 其他线程并发queueInLoop的任务全部在循环线程中执行，且同一线程投递的任务保持顺序
+TEST(EventLoopTest, CrossThreadTasksRunInOrder) {
+  EventLoopThread thread;
+  EventLoop* loop = thread.startLoop();
+
+  const int kProducers = 4;
+  const int kPerProducer = 20000;
+  std::vector<int> next(kProducers, 0);  // 只在循环线程中访问
+  std::atomic<int> done(0);
+  std::atomic<bool> ordered(true);
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&, p] {
+      for (int i = 0; i < kPerProducer; ++i) {
+        loop->queueInLoop([&, p, i] {
+          if (!loop->isInLoopThread() || next[p] != i) {
+            ordered = false;
+          }
+          next[p] = i + 1;
+          ++done;
+        });
+      }
+    });
+  }
+  for (std::thread& t : producers) {
+    t.join();
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while (done < kProducers * kPerProducer &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(kProducers * kPerProducer, done.load());
+  EXPECT_TRUE(ordered.load());
+}
+
+// 逐个投递并等待执行：每次投递时循环都可能刚好要进入睡眠，
+// 如果sleeping_握手丢失了唤醒，任务要等poll超时（10秒）才会执行
+TEST(EventLoopTest, NoLostWakeup) {
+  EventLoopThread thread;
+  EventLoop* loop = thread.startLoop();
+
+  const int kRounds = 2000;
+  std::mutex mutex;
+  std::condition_variable cond;
+  int ran = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kRounds; ++i) {
+    loop->queueInLoop([&] {
+      std::lock_guard<std::mutex> lock(mutex);
+      ++ran;
+      cond.notify_one();
+    });
+    std::unique_lock<std::mutex> lock(mutex);
+    ASSERT_TRUE(cond.wait_for(lock, std::chrono::seconds(5),
+                              [&] { return ran == i + 1; }))
+        << "task " << i << " was not woken up";
+  }
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(20));
+}
+
+// runInLoop在循环线程中同步执行
+TEST(EventLoopTest, RunInLoopFromLoopThreadIsSynchronous) {
+  EventLoopThread thread;
+  EventLoop* loop = thread.startLoop();
+
+  std::atomic<bool> checked(false);
+  std::atomic<bool> synchronous(false);
+  loop->queueInLoop([&] {
+    bool ran = false;
+    loop->runInLoop([&] { ran = true; });
+    synchronous = ran;
+    checked = true;
+  });
+  while (!checked) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_TRUE(synchronous.load());
+}
+
+// 其他线程投递的小回调使用预分配的队列节点，不在堆上分配
+TEST(EventLoopTest, CrossThreadQueueDoesNotAllocate) {
+  EventLoopThread thread;
+  EventLoop* loop = thread.startLoop();
+
+  std::atomic<int> ran(0);
+  const int kRounds = 1000;
+  int allocations = t_allocations;
+  for (int i = 0; i < kRounds; ++i) {
+    loop->queueInLoop([&ran] { ++ran; });  // 捕获放得进std::function内部
+    while (ran.load() != i + 1) {
+      std::this_thread::yield();
+    }
+  }
+  EXPECT_EQ(0, t_allocations - allocations);
+}
+
+// runAtIterationEnd的回调在本轮的队列回调之后、下一轮之前执行，
+// 回调中再登记的也在同一轮末尾执行
+TEST(EventLoopTest, IterationEndRunsBeforeNextIteration) {
+  EventLoopThread thread;
+  EventLoop* loop = thread.startLoop();
+
+  std::mutex mutex;
+  std::vector<std::string> order;
+  std::atomic<bool> done(false);
+  auto record = [&](const char* step) {
+    std::lock_guard<std::mutex> lock(mutex);
+    order.push_back(step);
+  };
+  loop->queueInLoop([&] {
+    loop->runAtIterationEnd([&] {
+      record("end");
+      loop->runAtIterationEnd([&] { record("nested end"); });
+    });
+    // 执行期间投递的回调留到下一轮
+    loop->queueInLoop([&] {
+      record("next");
+      done = true;
+    });
+    record("task");
+  });
+  while (!done) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<std::string> expected = {"task", "end", "nested end", "next"};
+  EXPECT_EQ(expected, order);
+}
+
+namespace {
+
+// 当前线程消耗的CPU时间（秒）
+double threadCpuSeconds() {
+  timespec ts;
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) + ts.tv_nsec / 1e9;
+}
+
+}  // namespace
+
+// 忙轮询期间循环不阻塞在poll中，其他线程投递的回调不需要写eventfd唤醒
+TEST(EventLoopTest, BusyPollRunsTasksWithoutWakeup) {
+  EventLoopThread thread(
+      [](EventLoop* loop) { loop->setBusyPoll(2 * 1000 * 1000); });
+  EventLoop* loop = thread.startLoop();
+
+  std::atomic<int> ran(0);
+  loop->queueInLoop([&] { ++ran; });
+  while (ran < 1) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  // 循环已经回到自旋中
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  uint64_t wakeups = loop->wakeupCount();
+  for (int i = 0; i < 10; ++i) {
+    loop->queueInLoop([&] { ++ran; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  while (ran < 11) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(wakeups, loop->wakeupCount());
+  EXPECT_EQ(2 * 1000 * 1000, loop->busyPollUs());
+}
+
+// 预算耗尽后退回阻塞的poll：空闲时不再占用CPU，投递回调需要eventfd唤醒
+TEST(EventLoopTest, BusyPollFallsBackToBlockingPoll) {
+  EventLoop loop;
+  loop.setBusyPoll(20 * 1000);
+  std::atomic<bool> ran(false);
+  std::thread producer([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    loop.queueInLoop([&] { ran = true; });
+  });
+  loop.runAfter(0.4, [&] { loop.quit(); });
+
+  double cpuStart = threadCpuSeconds();
+  loop.loop();
+  double cpu = threadCpuSeconds() - cpuStart;
+  producer.join();
+
+  EXPECT_TRUE(ran.load());
+  EXPECT_GE(loop.wakeupCount(), 1u);
+  // 每次进入poll最多自旋20ms，400ms中只有少数几轮
+  EXPECT_LT(cpu, 0.2);
+  EXPECT_LT(loop.stats().iterations, 10u);
+}
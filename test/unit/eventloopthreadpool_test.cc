@@ -0,0 +1,150 @@
+#include "thread/eventloopthreadpool.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "event/eventloop.h"
+
+using namespace Tnet;
+
+namespace {
+
+// 按一致性哈希为每个hashCode选择loop，返回loop在池中的下标
+std::vector<int> hashAssignments(EventLoopThreadPool* pool, int keys) {
+  std::vector<EventLoop*> loops = pool->getAllLoops();
+  std::vector<int> assignments;
+  for (int key = 0; key < keys; ++key) {
+    EventLoop* loop = pool->getNextLoop(key);
+    assignments.push_back(static_cast<int>(
+        std::find(loops.begin(), loops.end(), loop) - loops.begin()));
+  }
+  return assignments;
+}
+
+}  // namespace
+
+// 选择当前连接数最少的loop；连接数相同时仍然轮流分配
+TEST(EventLoopThreadPoolTest, LeastConnections) {
+  EventLoop baseLoop;
+  EventLoopThreadPool pool(&baseLoop, "least");
+  pool.setThreadNum(3);
+  pool.setLoadBalance(EventLoopThreadPool::kLeastConnections);
+  pool.start();
+  std::vector<EventLoop*> loops = pool.getAllLoops();
+  ASSERT_EQ(3u, loops.size());
+
+  EXPECT_EQ(loops[0], pool.getNextLoop());
+  EXPECT_EQ(loops[1], pool.getNextLoop());
+  EXPECT_EQ(loops[2], pool.getNextLoop());
+
+  loops[0]->incConnectionCount();
+  loops[0]->incConnectionCount();
+  loops[2]->incConnectionCount();
+  EXPECT_EQ(loops[1], pool.getNextLoop());
+  EXPECT_EQ(loops[1], pool.getNextLoop());
+
+  loops[1]->incConnectionCount();
+  loops[1]->incConnectionCount();
+  loops[1]->incConnectionCount();
+  EXPECT_EQ(loops[2], pool.getNextLoop());
+
+  // 连接关闭后负载下降，重新成为首选
+  loops[0]->decConnectionCount();
+  loops[0]->decConnectionCount();
+  EXPECT_EQ(loops[0], pool.getNextLoop());
+
+  loops[1]->decConnectionCount();
+  loops[1]->decConnectionCount();
+  loops[1]->decConnectionCount();
+  loops[2]->decConnectionCount();
+}
+
+// 连接数相同时（包括都不为0）按轮询顺序轮流选择，而不是总选第一个
+TEST(EventLoopThreadPoolTest, LeastConnectionsTiesRotate) {
+  EventLoop baseLoop;
+  EventLoopThreadPool pool(&baseLoop, "ties");
+  pool.setThreadNum(3);
+  pool.setLoadBalance(EventLoopThreadPool::kLeastConnections);
+  pool.start();
+  std::vector<EventLoop*> loops = pool.getAllLoops();
+  ASSERT_EQ(3u, loops.size());
+
+  for (EventLoop* loop : loops) {
+    loop->incConnectionCount();
+  }
+  for (int round = 0; round < 2; ++round) {
+    for (std::size_t i = 0; i < loops.size(); ++i) {
+      EXPECT_EQ(loops[i], pool.getNextLoop());
+    }
+  }
+
+  // loops[0]与loops[2]并列最少，二者交替，loops[1]不被选中
+  loops[1]->incConnectionCount();
+  std::vector<EventLoop*> picked;
+  for (int i = 0; i < 4; ++i) {
+    picked.push_back(pool.getNextLoop());
+  }
+  std::vector<EventLoop*> expected = {loops[0], loops[2], loops[0], loops[2]};
+  EXPECT_EQ(expected, picked);
+
+  loops[1]->decConnectionCount();
+  for (EventLoop* loop : loops) {
+    loop->decConnectionCount();
+  }
+}
+
+// 同一hashCode总是落在同一个loop上，不同的来源大致均匀地分布
+TEST(EventLoopThreadPoolTest, ConsistentHashIsStableAndBalanced) {
+  const int kKeys = 3000;
+  EventLoop baseLoop;
+  EventLoopThreadPool pool(&baseLoop, "hash");
+  pool.setThreadNum(3);
+  pool.setLoadBalance(EventLoopThreadPool::kConsistentHash);
+  pool.start();
+
+  std::vector<int> first = hashAssignments(&pool, kKeys);
+  EXPECT_EQ(first, hashAssignments(&pool, kKeys));
+
+  // 选择与连接数无关
+  pool.getAllLoops()[0]->incConnectionCount();
+  EXPECT_EQ(first, hashAssignments(&pool, kKeys));
+  pool.getAllLoops()[0]->decConnectionCount();
+
+  std::vector<int> counts(3, 0);
+  for (int index : first) {
+    ASSERT_GE(index, 0);
+    ASSERT_LT(index, 3);
+    ++counts[index];
+  }
+  for (int count : counts) {
+    EXPECT_GT(count, kKeys / 5);
+  }
+}
+
+// 增加一个loop时，只有落到新loop上的来源改变归属
+TEST(EventLoopThreadPoolTest, ConsistentHashMovesOnlyToNewLoop) {
+  const int kKeys = 3000;
+  EventLoop baseLoop;
+  EventLoopThreadPool small(&baseLoop, "small");
+  small.setThreadNum(3);
+  small.setLoadBalance(EventLoopThreadPool::kConsistentHash);
+  small.start();
+  EventLoopThreadPool large(&baseLoop, "large");
+  large.setThreadNum(4);
+  large.setLoadBalance(EventLoopThreadPool::kConsistentHash);
+  large.start();
+
+  std::vector<int> before = hashAssignments(&small, kKeys);
+  std::vector<int> after = hashAssignments(&large, kKeys);
+  int moved = 0;
+  for (int key = 0; key < kKeys; ++key) {
+    if (before[key] != after[key]) {
+      EXPECT_EQ(3, after[key]);
+      ++moved;
+    }
+  }
+  EXPECT_GT(moved, kKeys / 8);
+  EXPECT_LT(moved, kKeys / 2);
+}
@@ -0,0 +1,93 @@
+#include "event/loopstats.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include "event/eventloop.h"
+
+using namespace Tnet;
+
+// 0单独一个桶，第i个桶是[2^(i-1), 2^i)；分位数取所在桶的上界，不超过max
+TEST(HistogramTest, BucketsAndPercentiles) {
+  EXPECT_EQ(0, Histogram::bucketOf(0));
+  EXPECT_EQ(1, Histogram::bucketOf(1));
+  EXPECT_EQ(2, Histogram::bucketOf(2));
+  EXPECT_EQ(2, Histogram::bucketOf(3));
+  EXPECT_EQ(11, Histogram::bucketOf(1024));
+  EXPECT_EQ(Histogram::kBuckets - 1, Histogram::bucketOf(~uint64_t(0)));
+
+  Histogram histogram;
+  for (uint64_t value = 1; value <= 100; ++value) {
+    histogram.add(value);
+  }
+  EXPECT_EQ(100u, histogram.count);
+  EXPECT_EQ(5050u, histogram.sum);
+  EXPECT_EQ(100u, histogram.max);
+  EXPECT_DOUBLE_EQ(50.5, histogram.mean());
+  EXPECT_EQ(63u, histogram.percentile(0.5));   // 50落在[32, 64)
+  EXPECT_EQ(100u, histogram.percentile(0.99));  // 桶上界127超过max
+}
+
+// 其他线程读到的快照总是某一次record结束时的完整状态，各项计数一致
+TEST(LoopStatsRecorderTest, SnapshotIsConsistent) {
+  const uint64_t kSamples = 200000;
+  LoopStatsRecorder recorder;
+  std::atomic<bool> done(false);
+  std::atomic<int> inconsistent(0);
+  std::atomic<int> snapshots(0);
+
+  std::thread reader([&] {
+    while (!done) {
+      LoopStats stats = recorder.snapshot();
+      uint64_t n = stats.iterations;
+      uint64_t buckets = 0;
+      for (uint64_t bucket : stats.functorUs.buckets) {
+        buckets += bucket;
+      }
+      // 第i次record的各项值都是i或常数，和可以直接算出
+      if (stats.pollWaitUs.count != n || stats.dispatchUs.count != n ||
+          stats.eventsPerIteration.sum != n ||
+          stats.functorsPerIteration.sum != 2 * n ||
+          stats.pollWaitUs.sum != n * (n + 1) / 2 || buckets != n ||
+          (n > 0 && stats.pollWaitUs.max != n)) {
+        ++inconsistent;
+      }
+      ++snapshots;
+    }
+  });
+
+  for (uint64_t i = 1; i <= kSamples; ++i) {
+    LoopSample sample;
+    sample.pollWaitUs = i;
+    sample.events = 1;
+    sample.dispatchUs = 7;
+    sample.functors = 2;
+    sample.functorUs = i % 1000;
+    recorder.record(sample);
+  }
+  done = true;
+  reader.join();
+
+  EXPECT_GT(snapshots.load(), 0);
+  EXPECT_EQ(0, inconsistent.load());
+  EXPECT_EQ(kSamples, recorder.snapshot().iterations);
+}
+
+// EventLoop每轮记录一次，队列回调计入functorsPerIteration
+TEST(LoopStatsRecorderTest, EventLoopRecordsIterations) {
+  EventLoop loop;
+  const int kTasks = 5;
+  for (int i = 0; i < kTasks; ++i) {
+    loop.queueInLoop([] {});
+  }
+  loop.runAfter(0.02, [&] { loop.quit(); });
+  loop.loop();
+
+  LoopStats stats = loop.stats();
+  EXPECT_GT(stats.iterations, 0u);
+  EXPECT_EQ(stats.iterations, stats.pollWaitUs.count);
+  EXPECT_GE(stats.functorsPerIteration.sum, static_cast<uint64_t>(kTasks));
+  EXPECT_GE(stats.eventsPerIteration.sum, 1u);  // timerfd
+}
@@ -0,0 +1,78 @@
+#include "util/mpscqueue.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace Tnet;
+
+namespace {
+
+struct Item : public MpscNode {
+  Item(int p, int s) : producer(p), seq(s) {}
+  int producer;
+  int seq;
+};
+
+}  // namespace
+
+TEST(MpscQueueTest, EmptyQueuePopsNull) {
+  MpscQueue<Item> queue;
+  EXPECT_EQ(nullptr, queue.pop());
+}
+
+TEST(MpscQueueTest, SingleThreadFifo) {
+  MpscQueue<Item> queue;
+  std::vector<std::unique_ptr<Item>> items;
+  for (int i = 0; i < 100; ++i) {
+    items.emplace_back(new Item(0, i));
+    queue.push(items.back().get());
+  }
+  for (int i = 0; i < 100; ++i) {
+    Item* item = queue.pop();
+    ASSERT_NE(nullptr, item);
+    EXPECT_EQ(i, item->seq);
+  }
+  EXPECT_EQ(nullptr, queue.pop());
+
+  // 取空后再次使用，哨兵节点重新入队的路径
+  Item again(0, 100);
+  queue.push(&again);
+  EXPECT_EQ(&again, queue.pop());
+  EXPECT_EQ(nullptr, queue.pop());
+}
+
+// 多个生产者并发push，消费者取到全部节点，且同一生产者的节点保持顺序
+TEST(MpscQueueTest, ConcurrentProducersKeepPerProducerOrder) {
+  const int kProducers = 6;
+  const int kPerProducer = 50000;
+  MpscQueue<Item> queue;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&queue, p] {
+      for (int i = 0; i < kPerProducer; ++i) {
+        queue.push(new Item(p, i));
+      }
+    });
+  }
+
+  std::vector<int> next(kProducers, 0);
+  int received = 0;
+  while (received < kProducers * kPerProducer) {
+    Item* item = queue.pop();
+    if (item == nullptr) {
+      std::this_thread::yield();  // 队列为空或生产者处于push中间状态
+      continue;
+    }
+    ASSERT_EQ(next[item->producer], item->seq);
+    ++next[item->producer];
+    ++received;
+    delete item;
+  }
+  for (std::thread& t : producers) {
+    t.join();
+  }
+  EXPECT_EQ(nullptr, queue.pop());
+}
@@ -0,0 +1,696 @@
+#include "tcpserver/tcpconnection.h"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tcpserver/socket.h"
+#include "tcpserver/tcpserver.h"
+#include "testutil.h"
+
+using namespace Tnet;
+using Tnet::test::TestClient;
+using Tnet::test::runServer;
+
+namespace {
+
+// 每段数据的内容各不相同，顺序错乱或丢失时能比较出来
+std::string pattern(char tag, std::size_t len) {
+  std::string s(len, tag);
+  for (std::size_t i = 0; i < len; i += 97) {
+    s[i] = static_cast<char>(tag + i % 7);
+  }
+  return s;
+}
+
+// 内容为data的临时文件，创建后立即unlink，关闭fd时删除
+int tempFile(const std::string& data) {
+  char path[] = "/tmp/tnet_sendfile_XXXXXX";
+  int fd = ::mkstemp(path);
+  if (fd < 0) {
+    return -1;
+  }
+  ::unlink(path);
+  if (::write(fd, data.data(), data.size()) !=
+      static_cast<ssize_t>(data.size())) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// 当前进程中监听port的socket
+int findListenFd(uint16_t port) {
+  for (int fd = 0; fd < 1024; ++fd) {
+    int listening = 0;
+    socklen_t len = sizeof(listening);
+    sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    if (::getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) == 0 &&
+        listening &&
+        ::getsockname(fd, (sockaddr*)&addr, &addrlen) == 0 &&
+        addr.sin_family == AF_INET && ntohs(addr.sin_port) == port) {
+      return fd;
+    }
+  }
+  return -1;
+}
+
+// 服务端与client对应的已连接socket
+int findPeerFd(const TestClient& client) {
+  sockaddr_in local;
+  socklen_t len = sizeof(local);
+  if (::getsockname(client.fd(), (sockaddr*)&local, &len) < 0) {
+    return -1;
+  }
+  for (int fd = 0; fd < 1024; ++fd) {
+    sockaddr_in peer;
+    socklen_t peerlen = sizeof(peer);
+    if (fd != client.fd() &&
+        ::getpeername(fd, (sockaddr*)&peer, &peerlen) == 0 &&
+        peer.sin_family == AF_INET && peer.sin_port == local.sin_port) {
+      return fd;
+    }
+  }
+  return -1;
+}
+
+// 一个io线程的server，连接建立后调用onConnected
+class ConnectionFixture : public ::testing::Test {
+ protected:
+  ConnectionFixture() : server_(&loop_, InetAddress(0), "conn") {
+    server_.setThreadNum(1);
+    server_.setConnectionCallback([this](const TcpConnectionPtr& conn) {
+      if (conn->connected()) {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          conn_ = conn;
+        }
+        if (onConnected_) {
+          onConnected_(conn);
+        }
+      } else {
+        std::lock_guard<std::mutex> lock(mutex_);
+        conn_.reset();
+      }
+    });
+    server_.setMessageCallback(
+        [](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+          buf->retrieveAll();
+        });
+  }
+
+  void run(const std::function<void()>& body) {
+    runServer(&server_, &loop_, body);
+  }
+
+  TcpConnectionPtr waitConnection() {
+    for (int i = 0; i < 1000; ++i) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (conn_) {
+          return conn_;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return TcpConnectionPtr();
+  }
+
+  // server_最后声明，最先析构：io线程退出之前还会调用连接回调
+  EventLoop loop_;
+  std::function<void(const TcpConnectionPtr&)> onConnected_;
+  std::mutex mutex_;
+  TcpConnectionPtr conn_;
+  TcpServer server_;
+};
+
+using TcpConnectionTest = ConnectionFixture;
+
+}  // namespace
+
+// 零拷贝负载与之前、之后写入输出缓冲区的数据保持顺序
+TEST_F(TcpConnectionTest, ZeroCopyKeepsOrderWithBufferedData) {
+  const std::string a = pattern('a', 100000);
+  const std::string b = pattern('b', 300000);
+  const std::string c = pattern('c', 10);
+  const std::string d = pattern('d', 70000);
+  onConnected_ = [&](const TcpConnectionPtr& conn) {
+    conn->send(a);
+    conn->sendZeroCopy(std::make_shared<const std::string>(b));
+    conn->send(c);
+    conn->sendZeroCopy(std::make_shared<const std::string>(d));
+    conn->shutdown();
+  };
+
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    // 先不读，让数据积压在输出队列中
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_TRUE(client.readToEnd() == a + b + c + d);
+  });
+}
+
+// 其他线程调用sendZeroCopy，数据完整送达
+TEST_F(TcpConnectionTest, ZeroCopyFromOtherThread) {
+  const std::string payload = pattern('z', 500000);
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    TcpConnectionPtr conn = waitConnection();
+    ASSERT_TRUE(conn);
+    conn->sendZeroCopy(std::make_shared<const std::string>(payload));
+    conn->shutdown();
+    conn.reset();
+    EXPECT_TRUE(client.readToEnd() == payload);
+  });
+}
+
+// 文件片段夹在缓冲区数据与零拷贝负载之间，按调用顺序送达
+TEST_F(TcpConnectionTest, SendFileKeepsOrderWithOtherOutput) {
+  const std::string a = pattern('a', 50000);
+  const std::string file = pattern('f', 400000);
+  const std::string b = pattern('b', 200000);
+  const std::string c = pattern('c', 1000);
+  int fd = tempFile(file);
+  ASSERT_GE(fd, 0);
+  onConnected_ = [&](const TcpConnectionPtr& conn) {
+    conn->send(a);
+    conn->sendFile(fd, 100, 300000);
+    conn->sendZeroCopy(std::make_shared<const std::string>(b));
+    conn->sendFile(fd, 0, 100);
+    conn->send(c);
+    conn->shutdown();
+  };
+
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_TRUE(client.readToEnd() ==
+                a + file.substr(100, 300000) + b + file.substr(0, 100) + c);
+  });
+  ::close(fd);
+}
+
+// 其他线程调用sendFile后立即关闭自己的fd，连接使用的是dup出的fd
+TEST_F(TcpConnectionTest, SendFileFromOtherThread) {
+  const std::string file = pattern('g', 300000);
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    TcpConnectionPtr conn = waitConnection();
+    ASSERT_TRUE(conn);
+    int fd = tempFile(file);
+    ASSERT_GE(fd, 0);
+    conn->sendFile(fd, 0, file.size());
+    ::close(fd);
+    conn->shutdown();
+    conn.reset();
+    EXPECT_TRUE(client.readToEnd() == file);
+  });
+}
+
+// 管道不能作为sendfile的输入，直接拒绝，不影响前后的数据
+TEST_F(TcpConnectionTest, SendFileRejectsNonRegularFile) {
+  const std::string a = pattern('a', 1000);
+  const std::string b = pattern('b', 1000);
+  int pipefd[2];
+  ASSERT_EQ(0, ::pipe(pipefd));
+  ASSERT_EQ(3, ::write(pipefd[1], "abc", 3));
+  onConnected_ = [&](const TcpConnectionPtr& conn) {
+    conn->send(a);
+    conn->sendFile(pipefd[0], 0, 3);
+    conn->send(b);
+    conn->shutdown();
+  };
+
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    EXPECT_TRUE(client.readToEnd() == a + b);
+  });
+  ::close(pipefd[0]);
+  ::close(pipefd[1]);
+}
+
+// sendfile出错（这里是只写打开的文件）时丢弃文件并关闭连接，
+// 不会留在队首让写事件一直触发
+TEST_F(TcpConnectionTest, SendFileErrorClosesConnection) {
+  const std::string a = pattern('a', 4 * 1024 * 1024);
+  char path[] = "/tmp/tnet_sendfile_XXXXXX";
+  int tmp = ::mkstemp(path);
+  ASSERT_GE(tmp, 0);
+  ASSERT_EQ(4, ::write(tmp, "data", 4));
+  int fd = ::open(path, O_WRONLY | O_CLOEXEC);
+  ::unlink(path);
+  ::close(tmp);
+  ASSERT_GE(fd, 0);
+  onConnected_ = [&](const TcpConnectionPtr& conn) {
+    // 先积压在输出缓冲区，sendfile由写事件发起
+    conn->send(a);
+    conn->sendFile(fd, 0, 4);
+    conn->send(pattern('b', 1000));
+    conn->shutdown();
+  };
+
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(client.readToEnd() == a);
+    EXPECT_LT(std::chrono::steady_clock::now() - start,
+              std::chrono::seconds(5));
+    std::lock_guard<std::mutex> lock(mutex_);
+    EXPECT_FALSE(conn_);
+  });
+  ::close(fd);
+}
+
+// 其他线程发送的Slice在连接关闭后仍由任务持有，数据完整送达
+TEST_F(TcpConnectionTest, SliceFromOtherThread) {
+  const std::string payload = pattern('s', 600000);
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    TcpConnectionPtr conn = waitConnection();
+    ASSERT_TRUE(conn);
+    conn->send(Slice(std::string(payload)));
+    conn->shutdown();
+    conn.reset();
+    EXPECT_TRUE(client.readToEnd() == payload);
+  });
+}
+
+// 多个线程同时以各种方式发送，每个线程的数据按调用顺序送达。
+// 数据由32字节的记录组成：线程标记、序号、填充，按线程拆开后应当连续
+TEST_F(TcpConnectionTest, OutboundKeepsOrderPerThread) {
+  const int kThreads = 3;
+  const int kChunks = 40;
+  const std::size_t kRecord = 32;
+
+  std::vector<std::string> streams(kThreads);
+  for (int t = 0; t < kThreads; ++t) {
+    for (int j = 0; j < kChunks; ++j) {
+      int records = j * 37 % 3000 + 1;
+      for (int r = 0; r < records; ++r) {
+        std::string seq = std::to_string(streams[t].size() / kRecord);
+        std::string record(1, static_cast<char>('A' + t));
+        record += std::string(8 - seq.size(), '0') + seq;
+        record.resize(kRecord - 1, '.');
+        streams[t] += record + '\n';
+      }
+    }
+  }
+
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    TcpConnectionPtr conn = waitConnection();
+    ASSERT_TRUE(conn);
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < kThreads; ++t) {
+      producers.emplace_back([&, t] {
+        const std::string& stream = streams[t];
+        int fd = tempFile(stream);
+        std::size_t offset = 0;
+        for (int j = 0; j < kChunks; ++j) {
+          std::size_t len = (j * 37 % 3000 + 1) * kRecord;
+          switch (j % 4) {
+            case 0:
+              conn->send(stream.substr(offset, len));
+              break;
+            case 1:
+              conn->send(Slice(stream.data() + offset, len));
+              break;
+            case 2:
+              conn->sendZeroCopy(std::make_shared<const std::string>(
+                  stream.substr(offset, len)));
+              break;
+            case 3:
+              conn->sendFile(fd, offset, len);
+              break;
+          }
+          offset += len;
+        }
+        ::close(fd);
+      });
+    }
+    for (std::thread& producer : producers) {
+      producer.join();
+    }
+    conn->shutdown();
+    conn.reset();
+
+    std::string received = client.readToEnd();
+    std::size_t expected = 0;
+    for (const std::string& stream : streams) {
+      expected += stream.size();
+    }
+    ASSERT_EQ(expected, received.size());
+    std::vector<std::string> split(kThreads);
+    for (std::size_t i = 0; i < received.size(); i += kRecord) {
+      int t = received[i] - 'A';
+      ASSERT_TRUE(t >= 0 && t < kThreads);
+      split[t].append(received, i, kRecord);
+    }
+    for (int t = 0; t < kThreads; ++t) {
+      EXPECT_TRUE(split[t] == streams[t]) << "thread " << t;
+    }
+  });
+}
+
+namespace {
+
+// stopRead之后到达的数据留在内核中，startRead之后全部送达
+class ReadControlTest : public ConnectionFixture {
+ protected:
+  void checkPauseAndResume() {
+    const std::size_t kTotal = 256 * 1024;
+    std::atomic<std::size_t> received(0);
+    server_.setMessageCallback(
+        [&](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+          received += buf->readableBytes();
+          buf->retrieveAll();
+        });
+
+    run([&] {
+      TestClient client(server_.listenAddress());
+      ASSERT_TRUE(client.connected());
+      TcpConnectionPtr conn = waitConnection();
+      ASSERT_TRUE(conn);
+      conn->stopRead();
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+      ASSERT_TRUE(client.writeAll(std::string(kTotal, 'x')));
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      EXPECT_EQ(0u, received.load());
+
+      conn->startRead();
+      for (int i = 0; i < 1000 && received < kTotal; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      }
+      EXPECT_EQ(kTotal, received.load());
+    });
+  }
+};
+
+}  // namespace
+
+TEST_F(ReadControlTest, PauseAndResumeLevelTriggered) {
+  checkPauseAndResume();
+}
+
+// 边缘触发模式下暂停期间到达的数据不会再有新的边沿，恢复时必须主动读一次
+TEST_F(ReadControlTest, PauseAndResumeEdgeTriggered) {
+  server_.setEdgeTriggered(true);
+  checkPauseAndResume();
+}
+
+// 边缘触发模式下一次可读事件积压的数据超过循环的读缓冲区（256KB），
+// handleRead必须读到EAGAIN，否则剩余的数据不会再有通知
+TEST_F(TcpConnectionTest, EdgeTriggeredReadDrainsLargeBacklog) {
+  const std::size_t kTotal = 1024 * 1024;
+  std::atomic<std::size_t> received(0);
+  server_.setEdgeTriggered(true);
+  server_.setMessageCallback(
+      [&](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+        received += buf->readableBytes();
+        buf->retrieveAll();
+      });
+
+  run([&] {
+    // 接收缓冲区从监听socket继承，要装得下全部数据
+    int listenFd = findListenFd(server_.listenAddress().toPort());
+    ASSERT_GE(listenFd, 0);
+    int rcvbuf = 4 * 1024 * 1024;
+    ASSERT_EQ(0, ::setsockopt(listenFd, SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+                              sizeof(rcvbuf)));
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    TcpConnectionPtr conn = waitConnection();
+    ASSERT_TRUE(conn);
+
+    // 循环忙碌期间数据全部到达，之后只有一次可读事件
+    conn->getLoop()->queueInLoop([] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    });
+    ASSERT_TRUE(client.writeAll(std::string(kTotal, 'x')));
+    for (int i = 0; i < 200 && received < kTotal; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(kTotal, received.load());
+  });
+}
+
+// 合并发送模式下同一轮循环中的多次send先攒在输出缓冲区，
+// 本轮循环结束时一起发出，顺序不变
+TEST_F(TcpConnectionTest, CorkedSendsCoalesceInOrder) {
+  const std::string a = pattern('a', 100);
+  const std::string b = pattern('b', 2000);
+  const std::string c = pattern('c', 30000);
+  std::atomic<std::size_t> pendingAfterSends(0);
+  onConnected_ = [&](const TcpConnectionPtr& conn) {
+    conn->setCorked(true);
+    conn->send(a);
+    conn->send(b);
+    conn->send(c);
+    pendingAfterSends = conn->pendingOutputBytes();
+  };
+
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    EXPECT_TRUE(client.readExactly(a.size() + b.size() + c.size()) ==
+                a + b + c);
+    EXPECT_EQ(a.size() + b.size() + c.size(), pendingAfterSends.load());
+  });
+}
+
+// 其他线程调用flush，连接由任务持有，数据按序送达
+TEST_F(TcpConnectionTest, CorkedFlushFromOtherThread) {
+  const std::string a = pattern('a', 5000);
+  const std::string b = pattern('b', 300000);
+  onConnected_ = [&](const TcpConnectionPtr& conn) { conn->setCorked(true); };
+
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    TcpConnectionPtr conn = waitConnection();
+    ASSERT_TRUE(conn);
+    conn->send(a);
+    conn->flush();
+    conn->send(b);
+    conn->flush();
+    conn->shutdown();
+    conn.reset();
+    EXPECT_TRUE(client.readToEnd() == a + b);
+  });
+}
+
+// 合并发送模式下shutdown要等积压的数据在本轮循环末尾发完才关闭写端
+TEST_F(TcpConnectionTest, CorkedShutdownWaitsForFlush) {
+  const std::string a = pattern('a', 1000);
+  const std::string b = pattern('b', 2 * 1024 * 1024);
+  onConnected_ = [&](const TcpConnectionPtr& conn) {
+    conn->setCorked(true);
+    conn->send(a);
+    conn->send(b);
+    conn->shutdown();
+  };
+
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_TRUE(client.readToEnd() == a + b);
+  });
+}
+
+// 输入积压达到高水位后暂停读取，积压降到低水位（这里是0）时恢复
+TEST_F(TcpConnectionTest, InputThrottleResumesAtLowWaterMark) {
+  const std::size_t kTotal = 32 * 1024 * 1024;
+  const std::size_t kHighWaterMark = 64 * 1024;
+  std::atomic<std::size_t> received(0);
+  std::atomic<bool> released(false);
+  onConnected_ = [&](const TcpConnectionPtr& conn) {
+    conn->setInputWatermarks(kHighWaterMark, 0);
+  };
+  // 交给“工作线程”的数据在释放之前一直算作积压
+  server_.setMessageCallback(
+      [&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        received += buf->readableBytes();
+        buf->retrieveAll();
+        if (!released) {
+          conn->setInputBacklog(received);
+        }
+      });
+
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    TcpConnectionPtr conn = waitConnection();
+    ASSERT_TRUE(conn);
+    std::thread writer([&] { client.writeAll(std::string(kTotal, 'x')); });
+
+    // 接收量不再增长说明读取已暂停，内核缓冲区装不下全部数据
+    std::size_t last = 0;
+    for (int i = 0; i < 100; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      if (received > 0 && received == last) {
+        break;
+      }
+      last = received;
+    }
+    EXPECT_GE(received.load(), kHighWaterMark);
+    EXPECT_LT(received.load(), kTotal);
+
+    released = true;
+    conn->setInputBacklog(0);
+    for (int i = 0; i < 1000 && received < kTotal; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(kTotal, received.load());
+    // 没有恢复时writer阻塞在write上，shutdown让它返回
+    ::shutdown(client.fd(), SHUT_RDWR);
+    writer.join();
+  });
+}
+
+// 待发送数据越过高水位回调一次，对端读走后降到低水位再回调一次
+TEST_F(TcpConnectionTest, WriteWatermarksPairUp) {
+  const std::size_t kChunk = 64 * 1024;
+  const int kChunks = 64;
+  std::atomic<int> highCount(0);
+  std::atomic<int> lowCount(0);
+  std::atomic<std::size_t> highLevel(0);
+  onConnected_ = [&](const TcpConnectionPtr& conn) {
+    conn->setNotSentLowat(16 * 1024);
+    conn->setHighWaterMarkCallback(
+        [&](const TcpConnectionPtr&, std::size_t level) {
+          ++highCount;
+          highLevel = level;
+        },
+        256 * 1024);
+    conn->setLowWaterMarkCallback(
+        [&](const TcpConnectionPtr&, std::size_t) { ++lowCount; },
+        64 * 1024);
+    for (int i = 0; i < kChunks; ++i) {
+      conn->send(pattern(static_cast<char>('a' + i % 26), kChunk));
+    }
+    conn->shutdown();
+  };
+
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(1, highCount.load());
+    EXPECT_GE(highLevel.load(), 256 * 1024u);
+    EXPECT_EQ(0, lowCount.load());
+    EXPECT_EQ(kChunk * kChunks, client.readToEnd().size());
+    EXPECT_EQ(1, highCount.load());
+    EXPECT_EQ(1, lowCount.load());
+  });
+}
+
+// 超过输出上限的send整条丢弃，送达的都是完整的消息
+TEST_F(TcpConnectionTest, OutputLimitDropsWholeMessages) {
+  const std::size_t kMessage = 100 * 1000;
+  const int kMessages = 200;
+  std::atomic<std::size_t> dropped(0);
+  onConnected_ = [&](const TcpConnectionPtr& conn) {
+    conn->setNotSentLowat(16 * 1024);
+    conn->setOutputLimit(1024 * 1024, TcpConnection::kDropSend);
+    for (int i = 0; i < kMessages; ++i) {
+      conn->send(pattern(static_cast<char>('a' + i % 26), kMessage));
+    }
+    dropped = conn->droppedSends();
+    conn->shutdown();
+  };
+
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::string received = client.readToEnd();
+    EXPECT_GT(dropped.load(), 0u);
+    EXPECT_EQ((kMessages - dropped) * kMessage, received.size());
+    for (std::size_t i = 0; i + kMessage <= received.size(); i += kMessage) {
+      char tag = received[i];
+      ASSERT_TRUE(received.compare(i, kMessage, pattern(tag, kMessage)) == 0)
+          << "message at " << i;
+    }
+  });
+}
+
+// 0交给内核，表示使用sysctl的值，而不是UINT_MAX
+TEST(SocketTest, NotSentLowatZeroFallsBackToSysctl) {
+  Socket socket(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0));
+  unsigned int optval = 1;
+  socklen_t optlen = sizeof(optval);
+
+  socket.setNotSentLowat(16 * 1024);
+  ASSERT_EQ(0, ::getsockopt(socket.fd(), IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+                            &optval, &optlen));
+  EXPECT_EQ(16 * 1024u, optval);
+
+  socket.setNotSentLowat(0);
+  ASSERT_EQ(0, ::getsockopt(socket.fd(), IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+                            &optval, &optlen));
+  EXPECT_EQ(0u, optval);
+}
+
+// 所属循环开启忙轮询时，连接的socket也设置SO_BUSY_POLL；未开启时不设置
+TEST_F(TcpConnectionTest, BusyPollLoopSetsSocketBusyPoll) {
+  {
+    // 超过net.core.busy_read需要CAP_NET_ADMIN
+    Socket probe(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0));
+    int usec = 50;
+    if (::setsockopt(probe.fd(), SOL_SOCKET, SO_BUSY_POLL, &usec,
+                     sizeof(usec)) < 0) {
+      GTEST_SKIP() << "SO_BUSY_POLL not permitted";
+    }
+  }
+  server_.setThreadInitCallback(
+      [](EventLoop* loop) { loop->setBusyPoll(50); });
+
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    ASSERT_TRUE(waitConnection());
+    int fd = findPeerFd(client);
+    ASSERT_GE(fd, 0);
+    int usec = -1;
+    socklen_t len = sizeof(usec);
+    ASSERT_EQ(0, ::getsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usec, &len));
+    EXPECT_EQ(50, usec);
+  });
+}
+
+TEST_F(TcpConnectionTest, NoBusyPollLeavesSocketAlone) {
+  run([&] {
+    TestClient client(server_.listenAddress());
+    ASSERT_TRUE(client.connected());
+    ASSERT_TRUE(waitConnection());
+    int fd = findPeerFd(client);
+    ASSERT_GE(fd, 0);
+    int usec = -1;
+    socklen_t len = sizeof(usec);
+    ASSERT_EQ(0, ::getsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usec, &len));
+    EXPECT_EQ(0, usec);
+  });
+}
@@ -0,0 +1,241 @@
+#include "tcpserver/tcpserver.h"
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "testutil.h"
+
+using namespace Tnet;
+using Tnet::test::TestClient;
+using Tnet::test::runServer;
+
+namespace {
+
+void echo(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+  conn->send(buf);
+}
+
+// 对端已经关闭（读到EOF或RST）
+bool peerClosed(const TestClient& client) {
+  struct pollfd pfd = {client.fd(), POLLIN, 0};
+  if (::poll(&pfd, 1, 0) <= 0) {
+    return false;
+  }
+  char c;
+  return ::read(client.fd(), &c, 1) <= 0;
+}
+
+}  // namespace
+
+// 端口为0时所有subloop的监听器绑定同一个内核分配的端口，每个连接都能得到服务
+TEST(TcpServerTest, ReusePortPerLoopSharesEphemeralPort) {
+  EventLoop loop;
+  TcpServer server(&loop, InetAddress(0), "perloop",
+                   TcpServer::kReusePortPerLoop);
+  server.setThreadNum(3);
+  server.setConnectionCallback(defaultConnectionCallback);
+  server.setMessageCallback(echo);
+
+  runServer(&server, &loop, [&] {
+    uint16_t port = server.listenAddress().toPort();
+    ASSERT_NE(0, port);
+    // 各subloop的listen在自己的线程中异步执行，等它们都开始监听
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::vector<std::unique_ptr<TestClient>> clients;
+    for (int i = 0; i < 30; ++i) {
+      clients.emplace_back(new TestClient(InetAddress(port)));
+      ASSERT_TRUE(clients.back()->connected());
+    }
+    for (std::size_t i = 0; i < clients.size(); ++i) {
+      std::string message = "hello " + std::to_string(i);
+      ASSERT_TRUE(clients[i]->writeAll(message));
+      EXPECT_EQ(message, clients[i]->readExactly(message.size()));
+    }
+  });
+
+  EXPECT_EQ(30u, server.acceptStats().accepted);
+  EXPECT_EQ(0, server.acceptStats().acceptQueue);
+}
+
+// 循环已经停止时析构不会等待永远不会执行的回调
+TEST(TcpServerTest, PerLoopServerDestroyedAfterLoopStops) {
+  EventLoop loop;
+  std::unique_ptr<TcpServer> server(new TcpServer(
+      &loop, InetAddress(0), "stopped", TcpServer::kReusePortPerLoop));
+  server->setConnectionCallback(defaultConnectionCallback);
+  server->setMessageCallback(echo);
+  runServer(server.get(), &loop, [] {});
+  ASSERT_FALSE(loop.looping());
+
+  std::atomic<bool> destroyed(false);
+  std::thread destroyer([&] {
+    server.reset();
+    destroyed = true;
+  });
+  for (int i = 0; i < 200 && !destroyed; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_TRUE(destroyed.load());
+  destroyer.join();
+}
+
+// 端口为0时连接名使用内核分配的端口
+TEST(TcpServerTest, ConnectionNamesUseResolvedPort) {
+  for (TcpServer::Option option :
+       {TcpServer::kNoReusePort, TcpServer::kReusePortPerLoop}) {
+    EventLoop loop;
+    std::mutex mutex;
+    std::string name;  // 在server之后析构，连接关闭时回调仍会写入
+    TcpServer server(&loop, InetAddress(0), "named", option);
+    server.setThreadNum(1);
+    server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+      std::lock_guard<std::mutex> lock(mutex);
+      name = conn->name();
+    });
+    server.setMessageCallback(echo);
+
+    runServer(&server, &loop, [&] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      TestClient client(server.listenAddress());
+      ASSERT_TRUE(client.connected());
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    });
+
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ("named-" + server.listenAddress().toIpPort() + "#1", name);
+  }
+}
+
+// 普通模式下构造时绑定，listenAddress立即是实际端口
+TEST(TcpServerTest, SingleAcceptorResolvesPort) {
+  EventLoop loop;
+  TcpServer server(&loop, InetAddress(0), "single");
+  server.setThreadNum(2);
+  server.setConnectionCallback(defaultConnectionCallback);
+  server.setMessageCallback(echo);
+  EXPECT_NE(0, server.listenAddress().toPort());
+
+  runServer(&server, &loop, [&] {
+    TestClient client(server.listenAddress());
+    ASSERT_TRUE(client.connected());
+    ASSERT_TRUE(client.writeAll("ping"));
+    EXPECT_EQ("ping", client.readExactly(4));
+  });
+}
+
+// 全连接队列溢出计数单调递增，与当前队列长度分开统计
+TEST(TcpServerTest, ListenOverflowCounter) {
+  if (::access("/proc/net/netstat", R_OK) != 0) {
+    GTEST_SKIP() << "/proc/net/netstat not available";
+  }
+  EventLoop loop;
+  TcpServer server(&loop, InetAddress(0), "overflow");
+  AcceptStats before = server.acceptStats();
+
+  // 只listen不accept、backlog为1的socket，后续的连接会让队列溢出
+  int listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  InetAddress any(0);
+  ASSERT_EQ(0, ::bind(listenFd, (const sockaddr*)any.getSockAddr(),
+                      sizeof(sockaddr_in)));
+  ASSERT_EQ(0, ::listen(listenFd, 1));
+  sockaddr_in local;
+  socklen_t len = sizeof(local);
+  ::getsockname(listenFd, (sockaddr*)&local, &len);
+
+  std::vector<int> clients;
+  for (int i = 0; i < 8; ++i) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    ::connect(fd, (const sockaddr*)&local, sizeof(local));
+    clients.push_back(fd);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  AcceptStats after = server.acceptStats();
+  EXPECT_GT(after.listenOverflows, before.listenOverflows);
+  EXPECT_GE(after.listenDrops, after.listenOverflows);  // 溢出也计入ListenDrops
+  EXPECT_EQ(0, after.acceptQueue);  // 本server的队列不受影响
+
+  for (int fd : clients) {
+    ::close(fd);
+  }
+  ::close(listenFd);
+}
+
+// 一次可读事件最多accept acceptBatch个连接，用满上限时计入batchFull
+TEST(TcpServerTest, AcceptBatchLimit) {
+  EventLoop loop;
+  TcpServer server(&loop, InetAddress(0), "batch");
+  server.setConnectionCallback(defaultConnectionCallback);
+  server.setMessageCallback(echo);
+  server.setAcceptBatch(4);
+  server.start();  // 在当前线程中同步listen
+
+  // 循环还没运行，连接都排在全连接队列中
+  std::vector<std::unique_ptr<TestClient>> clients;
+  for (int i = 0; i < 10; ++i) {
+    clients.emplace_back(new TestClient(server.listenAddress()));
+    ASSERT_TRUE(clients.back()->connected());
+  }
+  loop.runAfter(0.2, [&] { loop.quit(); });
+  loop.loop();
+
+  AcceptStats stats = server.acceptStats();
+  EXPECT_EQ(10u, stats.accepted);
+  EXPECT_EQ(2u, stats.batchFull);  // 4 + 4 + 2
+  EXPECT_EQ(0u, stats.rejected);
+}
+
+// fd耗尽时多余的连接被accept后立即关闭，对端很快得到断开，
+// 监听fd不会一直可读把循环空转
+TEST(TcpServerTest, RejectsConnectionsWhenFdsExhausted) {
+  const int kClients = 20;
+  EventLoop loop;
+  TcpServer server(&loop, InetAddress(0), "emfile");
+  server.setConnectionCallback(defaultConnectionCallback);
+  server.setMessageCallback(echo);
+  server.start();
+
+  std::vector<std::unique_ptr<TestClient>> clients;
+  for (int i = 0; i < kClients; ++i) {
+    clients.emplace_back(new TestClient(server.listenAddress()));
+    ASSERT_TRUE(clients.back()->connected());
+  }
+
+  // 只给server留下很少的fd
+  struct rlimit saved;
+  ASSERT_EQ(0, ::getrlimit(RLIMIT_NOFILE, &saved));
+  int probe = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+  ASSERT_GE(probe, 0);
+  ::close(probe);
+  struct rlimit lowered = saved;
+  lowered.rlim_cur = probe + 2;
+  ASSERT_EQ(0, ::setrlimit(RLIMIT_NOFILE, &lowered));
+
+  uint64_t iterationsBefore = 0;
+  loop.runAfter(0.2, [&] { iterationsBefore = loop.stats().iterations; });
+  loop.runAfter(0.5, [&] { loop.quit(); });
+  loop.loop();
+  uint64_t idleIterations = loop.stats().iterations - iterationsBefore;
+  ::setrlimit(RLIMIT_NOFILE, &saved);
+
+  AcceptStats stats = server.acceptStats();
+  EXPECT_GT(stats.rejected, 0u);
+  EXPECT_EQ(static_cast<uint64_t>(kClients), stats.accepted + stats.rejected);
+  int closed = 0;
+  for (const auto& client : clients) {
+    closed += peerClosed(*client) ? 1 : 0;
+  }
+  EXPECT_EQ(stats.rejected, static_cast<uint64_t>(closed));
+  // 没有待处理的事件时每轮都要等到定时器，空转时会有成千上万轮
+  EXPECT_LT(idleIterations, 20u);
+}
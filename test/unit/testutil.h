@@ -0,0 +1,102 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "event/eventloop.h"
+#include "tcpserver/inetaddress.h"
+#include "tcpserver/tcpserver.h"
+
+namespace Tnet {
+namespace test {
+
+// 测试用的阻塞客户端，只在测试线程中使用
+class TestClient {
+ public:
+  explicit TestClient(const InetAddress& addr)
+      : fd_(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) {
+    connected_ = ::connect(fd_, (const sockaddr*)addr.getSockAddr(),
+                           sizeof(sockaddr_in)) == 0;
+  }
+  ~TestClient() { close(); }
+
+  TestClient(const TestClient&) = delete;
+  TestClient& operator=(const TestClient&) = delete;
+
+  bool connected() const { return connected_; }
+  int fd() const { return fd_; }
+
+  void setReceiveBuffer(int bytes) {
+    ::setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
+  }
+
+  bool writeAll(const std::string& data) {
+    std::size_t done = 0;
+    while (done < data.size()) {
+      ssize_t n = ::write(fd_, data.data() + done, data.size() - done);
+      if (n <= 0) {
+        return false;
+      }
+      done += n;
+    }
+    return true;
+  }
+
+  // 读满len字节，超时或对端关闭时返回已读到的部分
+  std::string readExactly(std::size_t len, int timeoutMs = 10000) {
+    std::string result;
+    char buf[65536];
+    while (result.size() < len) {
+      struct pollfd pfd = {fd_, POLLIN, 0};
+      if (::poll(&pfd, 1, timeoutMs) <= 0) {
+        break;
+      }
+      std::size_t want = std::min(sizeof(buf), len - result.size());
+      ssize_t n = ::read(fd_, buf, want);
+      if (n <= 0) {
+        break;
+      }
+      result.append(buf, n);
+    }
+    return result;
+  }
+
+  // 读到对端关闭为止
+  std::string readToEnd(int timeoutMs = 10000) {
+    return readExactly(static_cast<std::size_t>(-1), timeoutMs);
+  }
+
+  void close() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+ private:
+  int fd_;
+  bool connected_;
+};
+
+// 在base loop（当前线程）中运行server，body在另一个线程中执行客户端逻辑，
+// 结束后退出循环
+inline void runServer(TcpServer* server, EventLoop* loop,
+                      const std::function<void()>& body) {
+  server->start();
+  std::thread client([&] {
+    body();
+    loop->quit();
+  });
+  loop->loop();
+  client.join();
+}
+
+}  // namespace test
+}  // namespace Tnet
@@ -0,0 +1,98 @@
+#include "event/timerqueue.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "event/eventloop.h"
+#include "thread/eventloopthread.h"
+#include "util/timestamp.h"
+
+using namespace Tnet;
+
+// 定时器按到期时间先后触发，与添加顺序无关，并且不会提前
+TEST(TimerQueueTest, ExpiresInOrder) {
+  EventLoop loop;
+  const double delays[] = {0.05, 0.01, 0.04, 0.02, 0.03};
+  Timestamp start(Timestamp::now());
+  std::vector<double> fired;
+  for (double delay : delays) {
+    loop.runAfter(delay, [&, delay] {
+      EXPECT_GE(timeDifference(Timestamp::now(), start), delay);
+      fired.push_back(delay);
+    });
+  }
+  loop.runAfter(0.1, [&] { loop.quit(); });
+  loop.loop();
+
+  std::vector<double> expected = {0.01, 0.02, 0.03, 0.04, 0.05};
+  EXPECT_EQ(expected, fired);
+}
+
+// 同时到期的定时器在一次timerfd可读中批量处理，都在同一轮循环中执行
+TEST(TimerQueueTest, BatchExpiry) {
+  EventLoop loop;
+  const int kTimers = 100;
+  Timestamp when = addTime(Timestamp::now(), 0.02);
+  std::vector<uint64_t> iterations;
+  for (int i = 0; i < kTimers; ++i) {
+    loop.runAt(when, [&] { iterations.push_back(loop.stats().iterations); });
+  }
+  loop.runAfter(0.1, [&] { loop.quit(); });
+  loop.loop();
+
+  ASSERT_EQ(static_cast<std::size_t>(kTimers), iterations.size());
+  for (uint64_t iteration : iterations) {
+    EXPECT_EQ(iterations.front(), iteration);
+  }
+}
+
+// 其他线程添加和取消定时器，取消后不会触发
+TEST(TimerQueueTest, CancelFromOtherThread) {
+  EventLoopThread thread;
+  EventLoop* loop = thread.startLoop();
+
+  std::atomic<bool> cancelledFired(false);
+  std::atomic<bool> keptFired(false);
+  TimerId cancelled =
+      loop->runAfter(0.05, [&] { cancelledFired = true; });
+  loop->runAfter(0.05, [&] { keptFired = true; });
+  loop->cancel(cancelled);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  EXPECT_FALSE(cancelledFired.load());
+  EXPECT_TRUE(keptFired.load());
+}
+
+// 重复定时器按间隔触发，在自己的回调中取消后不再触发
+TEST(TimerQueueTest, CancelRepeatingTimerFromItsCallback) {
+  EventLoop loop;
+  int count = 0;
+  TimerId timer;
+  timer = loop.runEvery(0.01, [&] {
+    if (++count == 3) {
+      loop.cancel(timer);
+    }
+  });
+  loop.runAfter(0.15, [&] { loop.quit(); });
+  loop.loop();
+
+  EXPECT_EQ(3, count);
+}
+
+// 取消已经触发过的一次性定时器没有影响
+TEST(TimerQueueTest, CancelExpiredTimerIsHarmless) {
+  EventLoop loop;
+  int count = 0;
+  TimerId once = loop.runAfter(0.01, [&] { ++count; });
+  loop.runAfter(0.03, [&] {
+    loop.cancel(once);
+    loop.quit();
+  });
+  loop.loop();
+
+  EXPECT_EQ(1, count);
+}
@@ -0,0 +1,148 @@
+#include "event/timingwheel.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "event/eventloop.h"
+#include "util/timestamp.h"
+
+using namespace Tnet;
+
+namespace {
+
+// 0.1毫秒一个tick：根层覆盖25.6毫秒，第一层到1.6秒，之后落在第二层，
+// 几秒内就能覆盖两级级联
+const double kTick = 0.0001;
+
+struct Fired {
+  int id;
+  double elapsed;
+};
+
+}  // namespace
+
+// 分布在根层和上面两层的定时器都按时触发，触发顺序与到期时间一致
+TEST(TimingWheelTest, TimersFireInOrderAcrossLevels) {
+  EventLoop loop;
+  TimingWheel wheel(&loop, kTick);
+  const double timeouts[] = {0.005, 0.02, 0.2, 0.9, 1.7, 2.2};
+  const int kCount = sizeof(timeouts) / sizeof(timeouts[0]);
+
+  Timestamp start(Timestamp::now());
+  std::vector<Fired> fired;
+  std::vector<std::unique_ptr<WheelTimer>> timers;
+  for (int i = kCount - 1; i >= 0; --i) {
+    timers.emplace_back(new WheelTimer([&, i] {
+      fired.push_back({i, timeDifference(Timestamp::now(), start)});
+      if (static_cast<int>(fired.size()) == kCount) {
+        loop.quit();
+      }
+    }));
+    wheel.arm(timers.back().get(), timeouts[i]);
+  }
+  EXPECT_EQ(static_cast<std::size_t>(kCount), wheel.size());
+  loop.runAfter(10.0, [&] { loop.quit(); });  // 兜底
+  loop.loop();
+
+  ASSERT_EQ(static_cast<std::size_t>(kCount), fired.size());
+  for (int i = 0; i < kCount; ++i) {
+    EXPECT_EQ(i, fired[i].id);
+    EXPECT_GE(fired[i].elapsed, timeouts[i]) << "timer " << i;
+    EXPECT_LT(fired[i].elapsed, timeouts[i] + 0.2) << "timer " << i;
+  }
+  EXPECT_EQ(0u, wheel.size());
+}
+
+// 取消的定时器不会触发；重新arm会重新计时
+TEST(TimingWheelTest, CancelAndRearm) {
+  EventLoop loop;
+  TimingWheel wheel(&loop, kTick);
+  bool cancelledFired = false;
+  double rearmedAt = 0.0;
+  Timestamp start(Timestamp::now());
+
+  WheelTimer cancelled([&] { cancelledFired = true; });
+  WheelTimer rearmed(
+      [&] { rearmedAt = timeDifference(Timestamp::now(), start); });
+  wheel.arm(&cancelled, 0.05);
+  wheel.arm(&rearmed, 0.05);
+  EXPECT_TRUE(cancelled.armed());
+  wheel.cancel(&cancelled);
+  EXPECT_FALSE(cancelled.armed());
+
+  loop.runAfter(0.03, [&] { wheel.arm(&rearmed, 0.3); });
+  loop.runAfter(0.5, [&] { loop.quit(); });
+  loop.loop();
+
+  EXPECT_FALSE(cancelledFired);
+  EXPECT_GE(rearmedAt, 0.33);
+  EXPECT_FALSE(rearmed.armed());
+}
+
+// 回调中可以重新arm自己，也可以取消同一槽位中尚未执行的定时器
+TEST(TimingWheelTest, ArmAndCancelFromCallback) {
+  EventLoop loop;
+  TimingWheel wheel(&loop, kTick);
+  int periodic = 0;
+  bool victimFired = false;
+
+  WheelTimer victim([&] { victimFired = true; });
+  WheelTimer killer([&] { wheel.cancel(&victim); });
+  WheelTimer self;
+  self.setCallback([&] {
+    if (++periodic < 5) {
+      wheel.arm(&self, 0.01);
+    }
+  });
+  wheel.arm(&killer, 0.02);
+  wheel.arm(&victim, 0.02);
+  wheel.arm(&self, 0.01);
+
+  loop.runAfter(0.3, [&] { loop.quit(); });
+  loop.loop();
+
+  EXPECT_EQ(5, periodic);
+  EXPECT_FALSE(victimFired);
+  EXPECT_EQ(0u, wheel.size());
+}
+
+// 在一个tick快结束时arm，也不会在下一个tick边界提前触发
+TEST(TimingWheelTest, NeverFiresEarly) {
+  const double tick = 0.05;
+  EventLoop loop;
+  TimingWheel wheel(&loop, tick);
+  WheelTimer keeper;  // 让时间轮先开始走
+  wheel.arm(&keeper, 10.0);
+
+  Timestamp armedAt;
+  double elapsed = -1.0;
+  WheelTimer timer([&] {
+    elapsed = timeDifference(Timestamp::now(), armedAt);
+    loop.quit();
+  });
+  loop.runAfter(tick * 0.9, [&] {
+    armedAt = Timestamp::now();
+    wheel.arm(&timer, tick);
+  });
+  loop.runAfter(1.0, [&] { loop.quit(); });  // 兜底
+  loop.loop();
+
+  EXPECT_GE(elapsed, tick);
+  EXPECT_LT(elapsed, 3 * tick);
+}
+
+// 析构时仍挂在时间轮上的定时器自动摘下
+TEST(TimingWheelTest, TimerDestroyedWhileArmed) {
+  EventLoop loop;
+  TimingWheel wheel(&loop, kTick);
+  {
+    WheelTimer timer([] { FAIL() << "destroyed timer fired"; });
+    wheel.arm(&timer, 0.01);
+    EXPECT_EQ(1u, wheel.size());
+  }
+  EXPECT_EQ(0u, wheel.size());
+  loop.runAfter(0.05, [&] { loop.quit(); });
+  loop.loop();
+}
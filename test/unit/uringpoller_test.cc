@@ -0,0 +1,135 @@
+#include "event/uringpoller.h"
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+#include "event/channel.h"
+#include "event/eventloop.h"
+
+using namespace Tnet;
+
+namespace {
+
+// 使用io_uring的EventLoop，内核不支持时为nullptr
+std::unique_ptr<EventLoop> newUringLoop() {
+  ::setenv("TNET_USE_URING", "1", 1);
+  std::unique_ptr<EventLoop> loop(new EventLoop);
+  ::unsetenv("TNET_USE_URING");
+  if (!UringPoller(loop.get()).valid()) {
+    loop.reset();
+  }
+  return loop;
+}
+
+// 非阻塞管道的读端挂在channel上，记录读到的数据和空读的次数
+struct PipeReader {
+  explicit PipeReader(EventLoop* loop) : spurious(0) {
+    int fds[2];
+    if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+      readFd = writeFd = -1;
+      return;
+    }
+    readFd = fds[0];
+    writeFd = fds[1];
+    channel.reset(new Channel(loop, readFd));
+    channel->setReadCallback([this](Timestamp) {
+      char buf[64];
+      ssize_t n = ::read(readFd, buf, sizeof(buf));
+      if (n > 0) {
+        received.append(buf, n);
+      } else {
+        ++spurious;
+      }
+    });
+  }
+  ~PipeReader() {
+    detach();
+    closeRead();
+    if (writeFd >= 0) {
+      ::close(writeFd);
+    }
+  }
+
+  void detach() {
+    if (channel) {
+      channel->disableAll();
+      channel->remove();
+      channel.reset();
+    }
+  }
+  void closeRead() {
+    if (readFd >= 0) {
+      ::close(readFd);
+      readFd = -1;
+    }
+  }
+
+  int readFd;
+  int writeFd;
+  std::unique_ptr<Channel> channel;
+  std::string received;
+  int spurious;
+};
+
+}  // namespace
+
+// 可读事件按水平触发语义重复通知，直到数据被读走
+TEST(UringPollerTest, ReadEventsAreDelivered) {
+  std::unique_ptr<EventLoop> loop = newUringLoop();
+  if (!loop) {
+    GTEST_SKIP() << "io_uring not available";
+  }
+  PipeReader reader(loop.get());
+  ASSERT_GE(reader.readFd, 0);
+  reader.channel->enableReading();
+
+  loop->runAfter(0.02, [&] {
+    ASSERT_EQ(5, ::write(reader.writeFd, "hello", 5));
+  });
+  loop->runAfter(0.05, [&] {
+    ASSERT_EQ(5, ::write(reader.writeFd, "world", 5));
+  });
+  loop->runAfter(0.1, [&] { loop->quit(); });
+  loop->loop();
+
+  EXPECT_EQ("helloworld", reader.received);
+  EXPECT_EQ(0, reader.spurious);
+}
+
+// 关闭一个已提交poll的fd，同一轮中复用相同的fd号：
+// 新的channel必须重新提交poll，旧poll的完成事件不能分发给它
+TEST(UringPollerTest, ReusedFdIsPolledAgain) {
+  std::unique_ptr<EventLoop> loop = newUringLoop();
+  if (!loop) {
+    GTEST_SKIP() << "io_uring not available";
+  }
+  PipeReader first(loop.get());
+  ASSERT_GE(first.readFd, 0);
+  first.channel->enableReading();
+  std::unique_ptr<PipeReader> second;
+
+  loop->runAfter(0.02, [&] {
+    int fd = first.readFd;
+    first.detach();
+    first.closeRead();
+    second.reset(new PipeReader(loop.get()));
+    ASSERT_EQ(fd, second->readFd);
+    second->channel->enableReading();
+    // 旧管道的读端仍被旧poll引用，写入会让它完成
+    ASSERT_EQ(3, ::write(first.writeFd, "old", 3));
+    ASSERT_EQ(3, ::write(second->writeFd, "new", 3));
+  });
+  loop->runAfter(0.1, [&] { loop->quit(); });
+  loop->loop();
+
+  ASSERT_TRUE(second);
+  EXPECT_EQ("", first.received);
+  EXPECT_EQ("new", second->received);
+  EXPECT_EQ(0, second->spurious);
+  second.reset();
+}
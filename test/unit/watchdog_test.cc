@@ -0,0 +1,204 @@
+#include "event/watchdog.h"
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <spdlog/sinks/ostream_sink.h>
+#include <spdlog/spdlog.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "event/channel.h"
+#include "event/eventloop.h"
+
+using namespace Tnet;
+
+namespace {
+
+// 把默认logger换成写到字符串的logger，析构时恢复
+class LogCapture {
+ public:
+  LogCapture() : saved_(spdlog::default_logger()) {
+    auto sink = std::make_shared<spdlog::sinks::ostream_sink_mt>(stream_);
+    sink->set_pattern("%v");
+    spdlog::set_default_logger(
+        std::make_shared<spdlog::logger>("capture", sink));
+  }
+  ~LogCapture() { spdlog::set_default_logger(saved_); }
+
+  // 以prefix开头的行
+  std::vector<std::string> lines(const std::string& prefix) {
+    std::vector<std::string> result;
+    std::istringstream in(stream_.str());
+    std::string line;
+    while (std::getline(in, line)) {
+      if (line.compare(0, prefix.size(), prefix) == 0) {
+        result.push_back(line);
+      }
+    }
+    return result;
+  }
+
+ private:
+  std::shared_ptr<spdlog::logger> saved_;
+  std::ostringstream stream_;
+};
+
+// 管道读端挂在带名字的channel上，可读时执行onRead
+struct NamedPipe {
+  NamedPipe(EventLoop* loop, const std::string& name) {
+    int fds[2];
+    if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+      readFd = writeFd = -1;
+      return;
+    }
+    readFd = fds[0];
+    writeFd = fds[1];
+    channel.reset(new Channel(loop, readFd));
+    channel->setName(name);
+    channel->setReadCallback([this](Timestamp) {
+      char c;
+      ssize_t n = ::read(readFd, &c, 1);
+      (void)n;
+      if (onRead) {
+        onRead();
+      }
+    });
+    channel->enableReading();
+  }
+  ~NamedPipe() {
+    channel->disableAll();
+    channel->remove();
+    ::close(readFd);
+    ::close(writeFd);
+  }
+
+  void trigger() {
+    ssize_t n = ::write(writeFd, "x", 1);
+    (void)n;
+  }
+
+  int readFd;
+  int writeFd;
+  std::unique_ptr<Channel> channel;
+  std::function<void()> onRead;
+};
+
+std::string stallPrefix(EventLoop* loop) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "Watchdog: EventLoop %p ", loop);
+  return buf;
+}
+
+}  // namespace
+
+// 超过阈值的回调只报告一次，报告中是所在的循环、fd与channel名字；
+// 短于阈值的回调不报告
+TEST(WatchdogTest, ReportsStallOnce) {
+  LogCapture capture;
+  EventLoop loop;
+  NamedPipe slow(&loop, "slow-connection");
+  NamedPipe fast(&loop, "fast-connection");
+  ASSERT_GE(slow.readFd, 0);
+  ASSERT_GE(fast.readFd, 0);
+  // 阈值50ms，每12.5ms检查一次：300ms的卡顿会被检查到多次
+  slow.onRead = [] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  };
+  fast.onRead = [] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  };
+
+  Watchdog watchdog(0.05);
+  watchdog.setDumpStack(false);
+  watchdog.watch(&loop);
+  watchdog.start();
+
+  loop.runAfter(0.02, [&] { fast.trigger(); });
+  loop.runAfter(0.1, [&] { slow.trigger(); });
+  loop.runAfter(0.5, [&] { fast.trigger(); });
+  loop.runAfter(0.6, [&] { loop.quit(); });
+  loop.loop();
+
+  watchdog.stop();
+  watchdog.unwatch(&loop);
+
+  std::vector<std::string> reports = capture.lines("Watchdog:");
+  ASSERT_EQ(1u, reports.size());
+  const std::string& report = reports[0];
+  EXPECT_EQ(0u, report.find(stallPrefix(&loop)));
+  char where[64];
+  snprintf(where, sizeof(where), "fd=%d name=slow-connection", slow.readFd);
+  EXPECT_NE(std::string::npos, report.find(where)) << report;
+}
+
+// 打印调用栈的信号使用SA_RESTART：卡在可重启的阻塞调用中的回调不会被打断，
+// 信号处理函数把channel的fd与名字写到stderr
+TEST(WatchdogTest, StackDumpDoesNotInterruptBlockingRead) {
+  EventLoop loop;
+  NamedPipe stalled(&loop, "blocked-connection");
+  ASSERT_GE(stalled.readFd, 0);
+  int blocking[2];
+  ASSERT_EQ(0, ::pipe2(blocking, O_CLOEXEC));
+  ssize_t readResult = 0;
+  int readErrno = 0;
+  stalled.onRead = [&] {
+    char c;
+    readResult = ::read(blocking[0], &c, 1);
+    readErrno = errno;
+  };
+
+  // stderr重定向到临时文件
+  char path[] = "/tmp/tnet_watchdog_XXXXXX";
+  int logFd = ::mkstemp(path);
+  ASSERT_GE(logFd, 0);
+  ::unlink(path);
+  ::fflush(stderr);
+  int savedStderr = ::dup(STDERR_FILENO);
+  ::dup2(logFd, STDERR_FILENO);
+
+  Watchdog watchdog(0.05);
+  watchdog.watch(&loop);
+  watchdog.start();
+
+  std::thread writer([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    ssize_t n = ::write(blocking[1], "y", 1);
+    (void)n;
+  });
+  loop.runAfter(0.01, [&] { stalled.trigger(); });
+  loop.runAfter(0.4, [&] { loop.quit(); });
+  loop.loop();
+  writer.join();
+
+  watchdog.stop();
+  watchdog.unwatch(&loop);
+  ::fflush(stderr);
+  ::dup2(savedStderr, STDERR_FILENO);
+  ::close(savedStderr);
+
+  std::string dumped;
+  char buf[4096];
+  ssize_t n;
+  ::lseek(logFd, 0, SEEK_SET);
+  while ((n = ::read(logFd, buf, sizeof(buf))) > 0) {
+    dumped.append(buf, n);
+  }
+  ::close(logFd);
+  ::close(blocking[0]);
+  ::close(blocking[1]);
+
+  EXPECT_EQ(1, readResult) << "errno=" << readErrno;
+  char where[64];
+  snprintf(where, sizeof(where), "stalled in fd=%d name=blocked-connection",
+           stalled.readFd);
+  EXPECT_NE(std::string::npos, dumped.find(where)) << dumped;
+}